@@ -39,9 +39,9 @@ typedef int bool;
 #endif /* C++ */
 
 #ifndef INLINE
-#ifdef inline
+#if defined(__cplusplus) || defined(inline)
 #define INLINE  inline
-#elsif defined(__inline)
+#elif defined(__inline)
 #define INLINE  __inline
 #else
 #define INLINE
@@ -155,6 +155,15 @@ static INLINE bool path_isdir(const char *path)
 	return false;
 }
 
+static INLINE bool path_mkdir(const char *path)
+{
+#ifdef _WIN32
+	return _mkdir(path) == 0;
+#else
+	return mkdir(path, 0777) == 0;
+#endif
+}
+
 static off_t path_getfilesize(const char *path)
 {
 	struct stat st;
@@ -8,6 +8,8 @@
 #include "snes9x/snes9x.h"
 #include "snes9x/memmap.h"
 #include "snes9x/apu/apu.h"
+#include "snes9x/context.h"
+#include "snes9x/snapshot.h"
 
 #include "../SPCFile.h"
 #include "SNESSystem.h"
@@ -72,8 +74,11 @@ bool8 S9xOpenSoundDevice(void)
 
 SNESSystem::SNESSystem() :
 	rom_size(0),
-	m_output(NULL)
+	m_output(NULL),
+	apu_only(false),
+	audio_only(false)
 {
+	m_context = S9xCreateContext();
 	sound_buffer = new uint8_t[2 * 2 * 48000 / 5];
 }
 
@@ -81,14 +86,19 @@ SNESSystem::~SNESSystem()
 {
 	Term();
 
+	S9xDestroyContext(m_context);
 	delete[] sound_buffer;
 }
 
 bool SNESSystem::Load(const uint8_t * rom, uint32_t romsize, const uint8_t * sram, uint32_t sramsize)
 {
+	S9xSetContext(m_context);
+
 	Term();
 
 	InitSnes9X();
+	apu_only = false;
+	Settings.AudioOnly = audio_only ? TRUE : FALSE;
 
 	if (!Memory.LoadROMSNSF(rom, romsize, sram, sramsize))
 		return false;
@@ -102,9 +112,35 @@ bool SNESSystem::Load(const uint8_t * rom, uint32_t romsize, const uint8_t * sra
 	return true;
 }
 
+bool SNESSystem::LoadSPC(const uint8_t * spc, uint32_t size)
+{
+	S9xSetContext(m_context);
+
+	Term();
+
+	InitSnes9X();
+	apu_only = true;
+	rom_size = 0;
+
+	// no ROM header to take the timing from
+	S9xAPUTimingSetSpeedup(0);
+
+	if (!S9xAPULoadSPC(spc, size))
+		return false;
+
+	S9xSetSoundMute(FALSE);
+
+	return true;
+}
+
 void SNESSystem::SoundInit(SNESSoundOut * output)
 {
+	S9xSetContext(m_context);
+
 	m_output = output;
+
+	// At the native 32 kHz rate the DSP output goes to m_output directly
+	S9xSetSoundOutput(output);
 }
 
 void SNESSystem::Init()
@@ -113,6 +149,8 @@ void SNESSystem::Init()
 
 void SNESSystem::Reset()
 {
+	S9xSetContext(m_context);
+
 	S9xReset();
 
 	rom_size = Memory.CalculatedSize;
@@ -120,14 +158,31 @@ void SNESSystem::Reset()
 
 void SNESSystem::Term()
 {
+	S9xSetContext(m_context);
+
     Memory.Deinit();
     S9xDeinitAPU();
 }
 
 void SNESSystem::CPULoop()
 {
+	S9xSetContext(m_context);
+
 	S9xSyncSound();
-	S9xMainLoop();
+
+	if (apu_only)
+		S9xAPURunFrame();
+	else
+		S9xMainLoop();
+
+	if (S9xIsSoundOutputDirect())
+	{
+		S9xAPULogEndFrame();
+
+		// The landed samples are out already, the rest waits for the next landing
+		S9xEndSoundFrame();
+		return;
+	}
 
 	unsigned bytes = (S9xGetSampleCount() << 1) & ~3;
 	ZeroMemory(sound_buffer, bytes);
@@ -139,13 +194,43 @@ void SNESSystem::CPULoop()
 	}
 }
 
+uint32_t SNESSystem::GetStateSize() const
+{
+	S9xSetContext(m_context);
+
+	return S9xFreezeSize();
+}
+
+bool SNESSystem::SaveState(void * buffer, uint32_t size) const
+{
+	S9xSetContext(m_context);
+
+	return S9xFreezeGameMem((uint8 *)buffer, size) ? true : false;
+}
+
+bool SNESSystem::LoadState(const void * buffer, uint32_t size)
+{
+	S9xSetContext(m_context);
+
+	return S9xUnfreezeGameMem((const uint8 *)buffer, size) ? true : false;
+}
+
+uint32_t SNESSystem::GetStateVersion() const
+{
+	return (S9xFreezeVersion() << 16) | S9xAPUFreezeVersion();
+}
+
 bool SNESSystem::IsLoaded() const
 {
+	S9xSetContext(m_context);
+
 	return (Memory.ROM != NULL);
 }
 
 bool SNESSystem::IsHiROM() const
 {
+	S9xSetContext(m_context);
+
 	return (Memory.HiROM != 0);
 }
 
@@ -156,16 +241,22 @@ uint8_t * GetROMPointer()
 
 uint32_t SNESSystem::GetFileOffset(uint32_t mem_offset) const
 {
+	S9xSetContext(m_context);
+
 	return Memory.ROMToFileOffsetMap[mem_offset];
 }
 
 uint32_t SNESSystem::GetMemoryOffset(uint32_t file_offset) const
 {
+	S9xSetContext(m_context);
+
 	return Memory.FileToROMOffsetMap[file_offset];
 }
 
 void SNESSystem::ReadROM(void * buffer, size_t size, uint32_t file_offset) const
 {
+	S9xSetContext(m_context);
+
 	uint32_t buf_offset = 0;
 	for (uint32_t off = file_offset; off < file_offset + size; off++)
 	{
@@ -177,6 +268,8 @@ void SNESSystem::ReadROM(void * buffer, size_t size, uint32_t file_offset) const
 
 void SNESSystem::WriteROM(const void * buffer, size_t size, uint32_t file_offset)
 {
+	S9xSetContext(m_context);
+
 	uint32_t buf_offset = 0;
 	for (uint32_t off = file_offset; off < file_offset + size; off++)
 	{
@@ -188,83 +281,237 @@ void SNESSystem::WriteROM(const void * buffer, size_t size, uint32_t file_offset
 
 void SNESSystem::DumpSPCSnapshot(void)
 {
+	S9xSetContext(m_context);
+
 	S9xDumpSPCSnapshot();
 }
 
+void SNESSystem::DumpSPCSnapshots(const std::vector<int> & key_ons)
+{
+	S9xSetContext(m_context);
+
+	S9xDumpSPCSnapshotsAtKeyOns(key_ons.data(), (int)key_ons.size());
+}
+
 bool SNESSystem::HasSPCDumpFinished(void) const
 {
+	S9xSetContext(m_context);
+
 	return (S9xTakingSPCSnapshot == FALSE) ? true : false;
 }
 
 bool SNESSystem::HasSPCDumpSucceeded(void) const
 {
-	return (S9xLastSPCSnapshot != NULL) ? true : false;
+	S9xSetContext(m_context);
+
+	return !S9xSPCSnapshots.empty();
 }
 
 SPCFile * SNESSystem::PopSPCDump(void)
 {
-	if (HasSPCDumpFinished() && HasSPCDumpSucceeded()) {
-		SPCFile * spc_file = S9xLastSPCSnapshot;
-		S9xLastSPCSnapshot = NULL;
-		return spc_file;
-	}
-	else {
-		return NULL;
-	}
+	S9xSetContext(m_context);
+
+	return S9xPopSPCSnapshot();
 }
 
 SPCFile * SNESSystem::DumpSPCSnapshotImmediately(void) const
 {
+	S9xSetContext(m_context);
+
 	return S9xSPCDump();
 }
 
 const uint8_t * SNESSystem::GetROMCoverage() const
 {
+	S9xSetContext(m_context);
+
 	return Memory.ROMCoverage;
 }
 
 uint32_t SNESSystem::GetROMCoverageSize() const
 {
+	S9xSetContext(m_context);
+
 	return Memory.ROMCoverageSize;
 }
 
 const uint32_t * SNESSystem::GetROMCoverageHistogram() const
 {
+	S9xSetContext(m_context);
+
 	return Memory.ROMCoverageHistogram;
 }
 
 const uint8_t * SNESSystem::GetAPURAMCoverage() const
 {
+	S9xSetContext(m_context);
+
 	return spc_core->get_ram_coverage();
 }
 
 uint32_t SNESSystem::GetAPURAMCoverageSize() const
 {
+	S9xSetContext(m_context);
+
 	return spc_core->get_ram_coverage_size();
 }
 
 const uint32_t * SNESSystem::GetAPURAMCoverageHistogram() const
 {
+	S9xSetContext(m_context);
+
 	return (const uint32_t *)spc_core->get_ram_coverage_histogram();
 }
 
+void SNESSystem::SetAPURAMAccessTracking(bool track)
+{
+	S9xSetContext(m_context);
+
+	if (track)
+	{
+		apuram_access.resize(0x10000);
+		spc_core->set_ram_access(&apuram_access[0]);
+	}
+	else
+	{
+		spc_core->set_ram_access(NULL);
+		std::vector<uint8_t>().swap(apuram_access);
+	}
+}
+
+const uint8_t * SNESSystem::GetAPURAMAccess() const
+{
+	S9xSetContext(m_context);
+
+	return spc_core->get_ram_access();
+}
+
 bool SNESSystem::GetDSPResetAccuracy() const
 {
+	S9xSetContext(m_context);
+
 	return (S9xAccurateDSPReset != FALSE) ? true : false;
 }
 
 void SNESSystem::SetDSPResetAccuracy(bool dsp_reset_accuracy)
 {
+	S9xSetContext(m_context);
+
 	S9xAccurateDSPReset = dsp_reset_accuracy ? TRUE : FALSE;
 }
 
+bool SNESSystem::GetDSPCoverageOnly() const
+{
+	S9xSetContext(m_context);
+
+	return (S9xCoverageOnlyDSP != FALSE) ? true : false;
+}
+
+void SNESSystem::SetDSPCoverageOnly(bool coverage_only)
+{
+	S9xSetContext(m_context);
+
+	S9xCoverageOnlyDSP = coverage_only ? TRUE : FALSE;
+	if (spc_core != NULL)
+	{
+		spc_core->dsp_set_coverage_only(coverage_only);
+	}
+}
+
+bool SNESSystem::GetAudioOnly() const
+{
+	return audio_only;
+}
+
+void SNESSystem::SetAudioOnly(bool enabled)
+{
+	S9xSetContext(m_context);
+
+	audio_only = enabled;
+	Settings.AudioOnly = enabled ? TRUE : FALSE;
+}
+
+uint64_t SNESSystem::GetIdleLoopSkippedCycles() const
+{
+	S9xSetContext(m_context);
+
+	return CPU.IdleLoopSkippedCycles;
+}
+
+bool SNESSystem::CheckVoicesReleased()
+{
+	S9xSetContext(m_context);
+
+	if (spc_core == NULL)
+	{
+		return false;
+	}
+
+	// a voice may have been keyed on and released again since the last call
+	bool key_on = spc_core->check_kon();
+	return !key_on && spc_core->dsp_voices_silent();
+}
+
+bool SNESSystem::SetAPULog(std::vector<uint8_t> * log)
+{
+	S9xSetContext(m_context);
+
+	// a replay only keeps up the bookkeeping of the direct output, not the resampler
+	if (log != NULL && !S9xIsSoundOutputDirect())
+	{
+		S9xSetAPULog(NULL);
+		return false;
+	}
+
+	S9xSetAPULog(log);
+	return true;
+}
+
+bool SNESSystem::ReplayAPUFrame(const std::vector<uint8_t> & log, size_t & pos)
+{
+	S9xSetContext(m_context);
+
+	if (!S9xReplayAPUFrame(log.data(), log.size(), &pos))
+	{
+		return false;
+	}
+
+	S9xEndSoundFrame();
+	return true;
+}
+
+uint32_t SNESSystem::GetAPUStateSize() const
+{
+	S9xSetContext(m_context);
+
+	return S9xAPUFreezeSize();
+}
+
+void SNESSystem::SaveAPUState(void * buffer) const
+{
+	S9xSetContext(m_context);
+
+	S9xAPUFreeze((uint8 *)buffer);
+}
+
+void SNESSystem::LoadAPUState(const void * buffer)
+{
+	S9xSetContext(m_context);
+
+	S9xAPUUnfreeze((uint8 *)buffer);
+}
+
 uint16_t SNESSystem::GetROMChecksum() const
 {
+	S9xSetContext(m_context);
+
 	return Memory.CalculatedChecksum;
 }
 
 void SNESSystem::FixROMChecksum(uint8_t * rom)
 {
+	S9xSetContext(m_context);
+
 	// Note: Input ROM must have the same format with the ROM loaded by Snes9x.
 
 	uint8 * ROM_origin = Memory.ROM;
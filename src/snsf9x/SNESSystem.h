@@ -2,9 +2,12 @@
 #pragma once
 
 #include <stdint.h>
+#include <vector>
 
 #include "../SPCFile.h"
 
+struct S9xContext;
+
 // Callback class, passed the audio data from the emulator
 struct SNESSoundOut
 {
@@ -20,6 +23,9 @@ public:
 	virtual ~SNESSystem();
 
 	bool Load(const uint8_t * rom, uint32_t romsize, const uint8_t * sram, uint32_t sramsize);
+	// Loads an SPC file image instead of a game. The APU then runs alone,
+	// and CPULoop() steps it by one NTSC frame.
+	bool LoadSPC(const uint8_t * spc, uint32_t size);
 	void SoundInit(SNESSoundOut * output);
 	void Init();
 	void Reset();
@@ -27,6 +33,15 @@ public:
 
 	void CPULoop();
 
+	// Complete emulator state, which can be loaded back into any system that
+	// has the same game loaded (ROM patches are kept)
+	uint32_t GetStateSize() const;
+	bool SaveState(void * buffer, uint32_t size) const;
+	bool LoadState(const void * buffer, uint32_t size);
+	// Layout version of the state. A state saved with another version
+	// must not be loaded, even if it has the same size.
+	uint32_t GetStateVersion() const;
+
 	bool IsLoaded() const;
 	bool IsHiROM() const;
 
@@ -36,8 +51,11 @@ public:
 	void ReadROM(void * buffer, size_t size, uint32_t file_offset) const;
 	void WriteROM(const void * buffer, size_t size, uint32_t file_offset);
 	void DumpSPCSnapshot(void);
+	// Takes a snapshot at each of the given key-ons (ascending, from 1)
+	void DumpSPCSnapshots(const std::vector<int> & key_ons);
 	bool HasSPCDumpFinished(void) const;
 	bool HasSPCDumpSucceeded(void) const;
+	// Returns the oldest snapshot taken so far, or NULL
 	SPCFile * PopSPCDump(void);
 	SPCFile * DumpSPCSnapshotImmediately(void) const;
 
@@ -49,9 +67,46 @@ public:
 	uint32_t GetAPURAMCoverageSize() const;
 	const uint32_t * GetAPURAMCoverageHistogram() const;
 
+	// Non-zero for every APU RAM byte the SPC700 or the DSP has touched since
+	// the last SPC snapshot (or since tracking started). Tracking costs time
+	// on every instruction, so it is off (NULL) unless enabled.
+	void SetAPURAMAccessTracking(bool track);
+	const uint8_t * GetAPURAMAccess() const;
+
 	bool GetDSPResetAccuracy() const;
 	void SetDSPResetAccuracy(bool dsp_reset_accuracy);
 
+	// Coverage-only DSP: everything the SPC700 can observe is emulated, but
+	// the audio output is silent
+	bool GetDSPCoverageOnly() const;
+	void SetDSPCoverageOnly(bool coverage_only);
+
+	// Audio-only profile: DMA and HDMA from memory to the VRAM, CGRAM and
+	// OAM data ports take their time but do not transfer, and their source
+	// is not counted in the ROM coverage (kept across Load())
+	bool GetAudioOnly() const;
+	void SetAudioOnly(bool enabled);
+
+	// Master clock cycles the 65c816 did not interpret because it was
+	// spinning in an idle loop (counted since reset, kept in the state)
+	uint64_t GetIdleLoopSkippedCycles() const;
+
+	// True if every DSP voice has released to zero and there was no key-on
+	// since the previous call
+	bool CheckVoicesReleased();
+
+	// APU log: while a log is set, every port write and APU time step of the
+	// 65c816 is appended to it, and CPULoop() ends each frame with a marker.
+	// ReplayAPUFrame() plays one frame back on the APU alone, starting from
+	// the APU state (see SaveAPUState()) that was saved when the log started.
+	// Only supported at the native output rate.
+	bool SetAPULog(std::vector<uint8_t> * log);
+	bool ReplayAPUFrame(const std::vector<uint8_t> & log, size_t & pos);
+
+	uint32_t GetAPUStateSize() const;
+	void SaveAPUState(void * buffer) const;
+	void LoadAPUState(const void * buffer);
+
 	uint16_t GetROMChecksum() const;
 	void FixROMChecksum(uint8_t * rom);
 
@@ -60,6 +115,12 @@ public:
 protected:
 	SNESSoundOut * m_output;
 
+	// Complete emulator state of this instance (see snes9x/context.h)
+	S9xContext * m_context;
+
 private:
 	uint8_t * sound_buffer;
+	std::vector<uint8_t> apuram_access;
+	bool apu_only;
+	bool audio_only;
 };
@@ -271,6 +271,8 @@ struct SRegisters
 #define PCl		PC.B.xPCl
 #define PB		PC.B.xPB
 
-extern struct SRegisters	Registers;
+extern THREAD_LOCAL struct SRegisters	*S9xRegisters;
+
+#define Registers	(*S9xRegisters)
 
 #endif
@@ -574,6 +574,9 @@ void SNES_SPC::end_frame( time_t end_time )
 #ifndef SNSFOPT_REMOVED
 void SNES_SPC::mark_as_read(uint16_t address)
 {
+	if (m.ram_access)
+		m.ram_access[address] = 1;
+
 	// mark only constant data
 	if (m.ram_write_coverage[address] == 1)
 	{
@@ -603,6 +606,9 @@ void SNES_SPC::mark_as_read(uint16_t address)
 
 void SNES_SPC::mark_as_written(uint16_t address)
 {
+	if (m.ram_access)
+		m.ram_access[address] = 1;
+
 	if (m.ram_write_coverage[address] < 0xff)
 	{
 		m.ram_write_coverage[address]++;
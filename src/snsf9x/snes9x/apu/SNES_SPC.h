@@ -102,15 +102,29 @@ public:
 	// Returns true if new key-on events occurred since last check. Useful for
 	// trimming silence while saving an SPC.
 	bool check_kon();
+
+#ifndef SNSFOPT_REMOVED
+	// Saves/loads the complete emulator state as raw memory, coverage and
+	// buffered samples included. Only valid for the same build. Loading keeps
+	// the output buffer of this emulator, which must have the same size as the
+	// one that was set when saving; the caller copies the samples in it.
+	long raw_state_size() const;
+	void save_raw_state( void* out ) const;
+	void load_raw_state( void const* in );
+#endif
 #endif
 
 //// Snes9x Accessor
 
 	void    dsp_set_spc_snapshot_callback( void (*callback) (void) );
-	void    dsp_dump_spc_snapshot( void );
+	void    dsp_dump_spc_snapshot( int key_ons = 0 );
 	void    dsp_set_stereo_switch( int );
 	uint8_t dsp_reg_value( int, int );
 	int     dsp_envx_value( int );
+#ifndef SNSFOPT_REMOVED
+	void    dsp_set_coverage_only( bool );
+	bool    dsp_voices_silent() const;
+#endif
 
 public:
 	BLARGG_DISABLE_NOTHROW
@@ -149,6 +163,14 @@ public:
 	const uint8_t * get_ram_coverage() const;
 	uint32_t get_ram_coverage_size() const;
 	const uint32_t * get_ram_coverage_histogram() const;
+
+	// Non-zero for every RAM byte that the SMP or DSP has touched since
+	// reset_ram_access(): code, data, sample directory, BRR and echo. Only
+	// kept while a 64K map is set (NULL stops it); the map is not part of the
+	// raw state.
+	void set_ram_access( uint8_t* map );
+	const uint8_t * get_ram_access() const;
+	void reset_ram_access();
 #endif
 
 private:
@@ -217,6 +239,7 @@ private:
 		uint8_t ram_write_coverage[0x10000];
 		uint32_t ram_coverage_size;
 		uint32_t ram_coverage_histogram[256];
+		uint8_t* ram_access;
 #endif
 	};
 	state_t m;
@@ -319,6 +342,7 @@ inline bool SNES_SPC::check_kon() { return dsp.check_kon(); }
 inline const SNES_SPC::uint8_t * SNES_SPC::get_ram_coverage() const { return m.ram_coverage; }
 inline SNES_SPC::uint32_t SNES_SPC::get_ram_coverage_size() const { return m.ram_coverage_size; }
 inline const SNES_SPC::uint32_t * SNES_SPC::get_ram_coverage_histogram() const { return m.ram_coverage_histogram; }
+inline const SNES_SPC::uint8_t * SNES_SPC::get_ram_access() const { return m.ram_access; }
 #endif
 
 #endif
@@ -33,6 +33,9 @@ blargg_err_t SNES_SPC::init( bool accurate_dsp_reset )
 {
 	memset( &m, 0, sizeof m );
 	dsp.init( RAM, accurate_dsp_reset );
+#ifndef SNSFOPT_REMOVED
+	dsp.set_ram_access( m.ram_access );
+#endif
 	
 	m.tempo = tempo_unit;
 	
@@ -207,6 +210,20 @@ void SNES_SPC::reset_coverage()
 	memset(m.ram_write_coverage, 0, 0x10000);
 	memset(m.ram_coverage_histogram, 0x00, sizeof(uint32_t) * 256);
 	m.ram_coverage_size = 0;
+	reset_ram_access();
+}
+
+void SNES_SPC::set_ram_access( uint8_t* map )
+{
+	m.ram_access = map;
+	dsp.set_ram_access( map );
+	reset_ram_access();
+}
+
+void SNES_SPC::reset_ram_access()
+{
+	if ( m.ram_access )
+		memset( m.ram_access, 0, 0x10000 );
 }
 #endif
 
@@ -411,9 +428,9 @@ void SNES_SPC::dsp_set_spc_snapshot_callback( void (*callback) (void) )
 	dsp.set_spc_snapshot_callback( callback );
 }
 
-void SNES_SPC::dsp_dump_spc_snapshot( void )
+void SNES_SPC::dsp_dump_spc_snapshot( int key_ons )
 {
-	dsp.dump_spc_snapshot();
+	dsp.dump_spc_snapshot( key_ons );
 }
 
 void SNES_SPC::dsp_set_stereo_switch( int value )
@@ -430,3 +447,15 @@ int SNES_SPC::dsp_envx_value( int ch )
 {
 	return dsp.envx_value( ch );
 }
+
+#ifndef SNSFOPT_REMOVED
+void SNES_SPC::dsp_set_coverage_only( bool enabled )
+{
+	dsp.set_coverage_only( enabled );
+}
+
+bool SNES_SPC::dsp_voices_silent() const
+{
+	return dsp.voices_silent();
+}
+#endif
@@ -139,4 +139,52 @@ void SNES_SPC::copy_state( unsigned char** io, copy_func_t copy )
 
 	copier.extra();
 }
+
+#ifndef SNSFOPT_REMOVED
+
+// The address of the saved emulator follows its bytes, so that pointers into
+// itself can be moved by the distance to the emulator that loads them
+
+long SNES_SPC::raw_state_size() const
+{
+	return sizeof (SNES_SPC) + sizeof (SNES_SPC const*);
+}
+
+void SNES_SPC::save_raw_state( void* out ) const
+{
+	SNES_SPC const* self = this;
+	memcpy( out, (void const*) this, sizeof (SNES_SPC) );
+	memcpy( (char*) out + sizeof (SNES_SPC), &self, sizeof self );
+}
+
+void SNES_SPC::load_raw_state( void const* in )
+{
+	// Keep what belongs to this instance rather than to the emulated hardware
+	sample_t* const buf_begin = m.buf_begin;
+	sample_t const* const buf_end = m.buf_end;
+	const char* const cpu_error = m.cpu_error;
+	void (*const callback) (void) = dsp.spc_snapshot_callback;
+	bool const coverage_only = dsp.is_coverage_only();
+	uint8_t* const ram_access = m.ram_access;
+	
+	SNES_SPC const* old_self;
+	memcpy( &old_self, (char const*) in + sizeof (SNES_SPC), sizeof old_self );
+	memcpy( (void*) this, in, sizeof (SNES_SPC) );
+	
+	ptrdiff_t const delta = (char*) this - (char const*) old_self;
+	require( m.buf_end - m.buf_begin == buf_end - buf_begin );
+	dsp.relocate( delta, m.buf_begin, m.buf_end, buf_begin );
+	if ( m.extra_pos )
+		m.extra_pos = (sample_t*) ((char*) m.extra_pos + delta);
+	
+	m.buf_begin = buf_begin;
+	m.buf_end   = buf_end;
+	m.cpu_error = cpu_error;
+	dsp.spc_snapshot_callback = callback;
+	dsp.set_coverage_only( coverage_only );
+	m.ram_access = ram_access;
+	dsp.set_ram_access( ram_access );
+}
+
+#endif
 #endif
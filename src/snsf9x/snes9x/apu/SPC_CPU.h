@@ -61,6 +61,40 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 	}
 #endif
 
+#if !SPC_MORE_ACCURACY && !defined(SNSFOPT_REMOVED)
+	// Most drivers wait for a timer tick with "MOV reg,timer / BEQ -". While
+	// the counter stays zero an iteration changes nothing but the time, so
+	// skip the iterations that read before the counter next increments (or
+	// all of them if the timer is stopped). The DSP is caught up by RUN_DSP
+	// when it is next accessed, as usual.
+	#define SKIP_TIMER_POLL( addr_, beq )\
+	{\
+		int ti = (addr_) - (r_t0out + 0xF0);\
+		if ( (unsigned) ti < timer_count && (beq) [0] == 0xF0 && (beq) [1] == 0xFC )\
+		{\
+			Timer* t = &m.timers [ti];\
+			if ( rel_time >= t->next_time )\
+				t = run_timer_( t, rel_time );\
+			if ( !t->counter )\
+			{\
+				int period = m.cycle_table [opcode] + m.cycle_table [0xF0];\
+				int n = -rel_time / period;\
+				if ( t->enabled )\
+				{\
+					rel_time_t tick = t->next_time +\
+							TIMER_MUL( t, IF_0_THEN_256( t->period - t->divider ) - 1 );\
+					int polls = (tick - 1 - rel_time) / period + 1;\
+					if ( n > polls )\
+						n = polls;\
+				}\
+				rel_time += n * period;\
+			}\
+		}\
+	}
+#else
+	#define SKIP_TIMER_POLL( addr_, beq )
+#endif
+
 #define TIME_ADJ( n )   (n)
 
 #define READ_TIMER( time, addr, out )       CPU_READ_TIMER( rel_time, TIME_ADJ(time), (addr), out )
@@ -206,6 +240,17 @@ loop:
 	if ( (rel_time += m.cycle_table [opcode]) > 0 )
 		goto out_of_time;
 	
+#ifndef SNSFOPT_REMOVED
+	if ( m.ram_access )
+	{
+		// instructions are at most three bytes long
+		unsigned addr = GET_PC();
+		m.ram_access [addr] = 1;
+		m.ram_access [(uint16_t) (addr + 1)] = 1;
+		m.ram_access [(uint16_t) (addr + 2)] = 1;
+	}
+#endif
+	
 	#ifdef SPC_CPU_OPCODE_HOOK
 		SPC_CPU_OPCODE_HOOK( GET_PC(), opcode );
 	#endif
@@ -278,6 +323,7 @@ loop:
 	case 0xE4: // MOV a,dp
 		++pc;
 		// 80% from timer
+		SKIP_TIMER_POLL( DP_ADDR( data ), pc );
 		READ_DP_TIMER( 0, data, a = nz );
 		goto loop;
 	
@@ -402,6 +448,7 @@ loop:
 	case 0xF9: // MOV X,dp+Y
 		data = (uint8_t) (data + y);
 	case 0xF8: // MOV X,dp
+		SKIP_TIMER_POLL( DP_ADDR( data ), pc + 1 );
 		READ_DP_TIMER( 0, data, x = nz );
 		goto inc_pc_loop;
 	
@@ -419,6 +466,7 @@ loop:
 	case 0xEB: // MOV Y,dp
 		// 70% from timer
 		pc++;
+		SKIP_TIMER_POLL( DP_ADDR( data ), pc );
 		READ_DP_TIMER( 0, data, y = nz );
 		goto loop;
 	
@@ -964,6 +1012,13 @@ loop:
 	
 	case 0x1F: // JMP [abs+X]
 		SET_PC( READ_PC16( pc ) + x );
+#ifndef SNSFOPT_REMOVED
+		if ( m.ram_access )
+		{
+			m.ram_access [GET_PC()] = 1; // jump table entry
+			m.ram_access [(uint16_t) (GET_PC() + 1)] = 1;
+		}
+#endif
 		// fall through
 	case 0x5F: // JMP abs
 		SET_PC( READ_PC16( pc ) );
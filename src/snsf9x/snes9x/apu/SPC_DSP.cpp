@@ -26,6 +26,12 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 	#error "Requires that int type have at least 32 bits"
 #endif
 
+// SSE2 is part of every x86-64 CPU, so it needs no runtime check
+#if !defined (SPC_DSP_NO_SSE2) && (defined (__SSE2__) || defined (_M_X64))
+	#define SPC_DSP_SSE2 1
+	#include <emmintrin.h>
+#endif
+
 // TODO: add to blargg_endian.h
 #define GET_LE16SA( addr )      ((BOOST::int16_t) GET_LE16( addr ))
 #define GET_LE16A( addr )       GET_LE16( addr )
@@ -69,6 +75,13 @@ static BOOST::uint8_t const initial_regs_clean [SPC_DSP::register_count] =
 // Access voice DSP register
 #define VREG(r,n)   r [v_##n]
 
+// Note a read of shared RAM (see SNES_SPC::get_ram_access())
+#ifndef SNSFOPT_REMOVED
+	#define MARK_RAM( addr )    (m.ram_access ? (void) (m.ram_access [(addr) & 0xFFFF] = 1) : (void) 0)
+#else
+	#define MARK_RAM( addr )    ((void) 0)
+#endif
+
 #define WRITE_SAMPLES( l, r, out ) \
 {\
 	out [0] = l;\
@@ -310,9 +323,37 @@ inline void SPC_DSP::decode_brr( voice_t* v )
 	if ( (v->buf_pos += 4) >= brr_buf_size )
 		v->buf_pos = 0;
 	
+#if SPC_DSP_SSE2
+	// Extract, sign-extend and shift all four nybbles at once
+	int const shift = header >> 4;
+	__m128i in = _mm_srai_epi32( _mm_set_epi32( nybbles << 28, nybbles << 24,
+			nybbles << 20, nybbles << 16 ), 28 );
+	if ( shift >= 0xD ) // handle invalid range
+		in = _mm_slli_epi32( _mm_srai_epi32( in, 31 ), 11 );
+	else
+		in = _mm_srai_epi32( _mm_sll_epi32( in, _mm_cvtsi32_si128( shift ) ), 1 );
+	
+	if ( !(header & 0x0C) )
+	{
+		// Without filter samples are within -0x4000..0x3800 (nybble -8 at
+		// shift 12), so doubled they still fit in 16 bits and need no clamp
+		in = _mm_add_epi32( in, in );
+		_mm_storeu_si128( (__m128i*) pos, in );
+		_mm_storeu_si128( (__m128i*) (pos + brr_buf_size), in );
+		return;
+	}
+	
+	int shifted [4];
+	_mm_storeu_si128( (__m128i*) shifted, in );
+	int const* next = shifted;
+#endif
+	
 	// Decode four samples
 	for ( end = pos + 4; pos < end; pos++, nybbles <<= 4 )
 	{
+	#if SPC_DSP_SSE2
+		int s = *next++;
+	#else
 		// Extract nybble and sign-extend
 		int s = (int16_t) nybbles >> 12;
 		
@@ -321,6 +362,7 @@ inline void SPC_DSP::decode_brr( voice_t* v )
 		s = (s << shift) >> 1;
 		if ( shift >= 0xD ) // handle invalid range
 			s = (s >> 25) << 11; // same as: s = (s < 0 ? -0x800 : 0)
+	#endif
 		
 		// Apply IIR filter (8 is the most commonly used)
 		int const filter = header & 0x0C;
@@ -380,6 +422,10 @@ MISC_CLOCK( 30 )
 	{
 		m.kon    = m.new_kon;
 		m.t_koff = REG(koff) | m.mute_mask; 
+		
+		// count down the key-ons to let through before a snapshot
+		if ( m.kon && take_spc_snapshot > 1 )
+			take_spc_snapshot--;
 	}
 	
 	run_counters();
@@ -409,6 +455,8 @@ inline VOICE_CLOCK( V2 )
 	if ( !v->kon_delay )
 		entry += 2;
 	m.t_brr_next_addr = GET_LE16A( entry );
+	MARK_RAM( entry - m.ram );
+	MARK_RAM( entry - m.ram + 1 );
 	
 	m.t_adsr0 = VREG(v->regs,adsr0);
 	
@@ -424,6 +472,9 @@ inline VOICE_CLOCK( V3b )
 	// Read BRR header and byte
 	m.t_brr_byte   = m.ram [(v->brr_addr + v->brr_offset) & 0xFFFF];
 	m.t_brr_header = m.ram [v->brr_addr]; // brr_addr doesn't need masking
+	MARK_RAM( v->brr_addr );
+	MARK_RAM( v->brr_addr + v->brr_offset );
+	MARK_RAM( v->brr_addr + v->brr_offset + 1 ); // read by decode_brr()
 }
 VOICE_CLOCK( V3c )
 {
@@ -442,7 +493,7 @@ VOICE_CLOCK( V3c )
 			m.t_brr_header = 0; // header is ignored on this sample
 			m.kon_check    = true;
 
-			if (take_spc_snapshot)
+			if (take_spc_snapshot == 1)
 			{
 				take_spc_snapshot = 0;
 				if (spc_snapshot_callback)
@@ -464,6 +515,16 @@ VOICE_CLOCK( V3c )
 	}
 	
 	// Gaussian interpolation
+#ifndef SNSFOPT_REMOVED
+	// A silent voice outputs zero whatever it interpolates. The others are
+	// interpolated even without output, as OUTX shows the result to the SMP.
+	if ( !v->env )
+	{
+		m.t_output = 0;
+		v->t_envx_out = (uint8_t) (v->env >> 4);
+	}
+	else
+#endif
 	{
 		int output = interpolate( v );
 		
@@ -504,6 +565,12 @@ VOICE_CLOCK( V3c )
 
 inline void SPC_DSP::voice_output( voice_t const* v, int ch )
 {
+#ifndef SNSFOPT_REMOVED
+	// Adds nothing to the main and echo totals
+	if ( !m.t_output )
+		return;
+#endif
+	
 	// Apply left/right volume
 	int amp = (m.t_output * (int8_t) VREG(v->regs,voll + ch)) >> 7;
 #if BLARGG_CPU_X86
@@ -625,6 +692,8 @@ VOICE_CLOCK(V9_V6_V3) { voice_V9(v); voice_V6(v+1); voice_V3(v+2); }
 inline void SPC_DSP::echo_read( int ch )
 {
 	int s = GET_LE16SA( ECHO_PTR( ch ) );
+	MARK_RAM( m.t_echo_ptr + ch * 2 );
+	MARK_RAM( m.t_echo_ptr + ch * 2 + 1 );
 	// second copy simplifies wrap-around handling
 	ECHO_FIR( 0 ) [ch] = ECHO_FIR( 8 ) [ch] = s >> 1;
 }
@@ -689,6 +758,11 @@ inline int SPC_DSP::echo_output( int ch )
 }
 ECHO_CLOCK( 26 )
 {
+#ifndef SNSFOPT_REMOVED
+	// No output; the FIR is still needed for the feedback, and the SMP can
+	// change its coefficients between clocks 22 and 25
+	if ( !coverage_only )
+#endif
 	// Left output volumes
 	// (save sample for next clock so we can output both together)
 	m.t_main_out [0] = echo_output( 0 );
@@ -706,8 +780,15 @@ ECHO_CLOCK( 26 )
 ECHO_CLOCK( 27 )
 {
 	// Output
-	int l = m.t_main_out [0];
-	int r = echo_output( 1 );
+	int l = 0;
+	int r = 0;
+#ifndef SNSFOPT_REMOVED
+	if ( !coverage_only )
+#endif
+	{
+		l = m.t_main_out [0];
+		r = echo_output( 1 );
+	}
 	m.t_main_out [0] = 0;
 	m.t_main_out [1] = 0;
 	
@@ -842,6 +923,7 @@ void SPC_DSP::init( void* ram_64k, bool accurate_dsp_reset )
 	disable_surround( false );
 	set_output( 0, 0 );
 	accurate_reset = accurate_dsp_reset;
+	coverage_only = false;
 	reset();
 
 	stereo_switch = 0xffff;
@@ -1059,6 +1141,53 @@ void SPC_DSP::copy_state( unsigned char** io, copy_func_t copy )
 }
 #endif
 
+#ifndef SNSFOPT_REMOVED
+
+template<class T>
+static inline void relocate_ptr( T*& p, ptrdiff_t delta )
+{
+	if ( p )
+		p = (T*) ((char*) p + delta);
+}
+
+void SPC_DSP::relocate( ptrdiff_t delta, sample_t const* old_out, sample_t const* old_out_end, sample_t* out )
+{
+	relocate_ptr( m.echo_hist_pos, delta );
+	relocate_ptr( m.ram, delta );
+	for ( int i = voice_count; --i >= 0; )
+		relocate_ptr( m.voices [i].regs, delta );
+	
+	// Output goes either to the caller's buffer or to our own extra buffer
+	ptrdiff_t const out_delta = (char*) out - (char*) old_out;
+	sample_t** const ptrs [3] = { &m.out, &m.out_end, &m.out_begin };
+	for ( int i = 0; i < 3; i++ )
+	{
+		sample_t*& p = *ptrs [i];
+		if ( old_out && p >= old_out && p <= old_out_end )
+			relocate_ptr( p, out_delta );
+		else
+			relocate_ptr( p, delta );
+	}
+}
+
+void SPC_DSP::set_coverage_only( bool enabled )
+{
+	coverage_only = enabled;
+}
+
+bool SPC_DSP::voices_silent() const
+{
+	for ( int i = voice_count; --i >= 0; )
+	{
+		voice_t const& v = m.voices [i];
+		if ( v.env || v.env_mode != env_release || v.kon_delay )
+			return false;
+	}
+	return true;
+}
+
+#endif
+
 
 //// Snes9x Accessor
 
@@ -1067,9 +1196,9 @@ void SPC_DSP::set_spc_snapshot_callback( void (*callback) (void) )
 	spc_snapshot_callback = callback;
 }
 
-void SPC_DSP::dump_spc_snapshot( void )
+void SPC_DSP::dump_spc_snapshot( int key_ons )
 {
-	take_spc_snapshot = 1;
+	take_spc_snapshot = key_ons + 1;
 }
 
 void SPC_DSP::set_stereo_switch( int value )
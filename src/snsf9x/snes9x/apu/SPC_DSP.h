@@ -65,6 +65,25 @@ public:
 	// Returns non-zero if new key-on events occurred since last call
 	bool check_kon();
 
+#ifndef SNSFOPT_REMOVED
+	// Fixes up internal pointers after the enclosing emulator was copied byte
+	// by byte from another one that was delta bytes away. Output pointers that
+	// were inside [old_out, old_out_end] are moved into out instead.
+	void relocate( ptrdiff_t delta, sample_t const* old_out, sample_t const* old_out_end, sample_t* out );
+
+	// Skips the work that only shapes the output samples, which become silent.
+	// Everything the SMP can observe is still emulated.
+	void set_coverage_only( bool );
+	bool is_coverage_only() const { return coverage_only; }
+
+	// Sets the 64K map where the DSP marks each RAM byte it reads (NULL for none)
+	void set_ram_access( uint8_t* map ) { m.ram_access = map; }
+
+	// True if every voice has released to zero and none is being keyed on.
+	// Such voices stay silent until the next KON (see check_kon()).
+	bool voices_silent() const;
+#endif
+
 // Snes9x Accessor
 
 	int  stereo_switch;
@@ -72,7 +91,9 @@ public:
 	void (*spc_snapshot_callback) (void);
 
 	void    set_spc_snapshot_callback( void (*callback) (void) );
-	void    dump_spc_snapshot( void );
+	// Calls the snapshot callback when the next voice is keyed on, after
+	// key_ons more KON writes have reached the voices
+	void    dump_spc_snapshot( int key_ons = 0 );
 	void    set_stereo_switch( int );
 	uint8_t reg_value( int, int );
 	int     envx_value( int );
@@ -192,6 +213,9 @@ private:
 		
 		// non-emulation state
 		uint8_t* ram; // 64K shared RAM between DSP and SMP
+#ifndef SNSFOPT_REMOVED
+		uint8_t* ram_access; // set for every byte of ram that is read
+#endif
 		int mute_mask;
 		sample_t* out;
 		sample_t* out_end;
@@ -246,6 +270,7 @@ private:
 	void soft_reset_common();
 
 	bool accurate_reset;
+	bool coverage_only;
 };
 
 #include <assert.h>
@@ -188,10 +188,6 @@
 #ifndef SNSFOPT_REMOVED
 #include "../SNESSystem.h"
 #include "../../SPCFile.h"
-
-SPCFile * S9xLastSPCSnapshot = NULL;
-bool8 S9xTakingSPCSnapshot = FALSE;
-bool8 S9xAccurateDSPReset = TRUE;
 #endif
 
 #define APU_DEFAULT_INPUT_RATE		32000
@@ -203,8 +199,6 @@ bool8 S9xAccurateDSPReset = TRUE;
 #define APU_DENOMINATOR_PAL			709379
 #define APU_DEFAULT_RESAMPLER		HermiteResampler
 
-SNES_SPC	*spc_core = NULL;
-
 static uint8 APUROM[64] =
 {
 	0xCD, 0xEF, 0xBD, 0xE8, 0x00, 0xC6, 0x1D, 0xD0,
@@ -217,33 +211,7 @@ static uint8 APUROM[64] =
 	0x5D, 0xD0, 0xDB, 0x1F, 0x00, 0x00, 0xC0, 0xFF
 };
 
-namespace spc
-{
-	static apu_callback	sa_callback     = NULL;
-	static void			*extra_data     = NULL;
-
-	static bool8		sound_in_sync   = TRUE;
-	static bool8		sound_enabled   = FALSE;
-
-	static int			buffer_size;
-	static int			lag_master      = 0;
-	static int			lag             = 0;
-
-	static uint8		*landing_buffer = NULL;
-	static uint8		*shrink_buffer  = NULL;
-
-	static Resampler	*resampler      = NULL;
-
-	static int32		reference_time;
-	static uint32		remainder;
-
-	static const int32	timing_hack_numerator   = SNES_SPC::tempo_unit;
-	static int32		timing_hack_denominator = SNES_SPC::tempo_unit;
-	/* Set these to NTSC for now. Will change to PAL in S9xAPUTimingSetSpeedup
-	   if necessary on game load. */
-	static uint32		ratio_numerator = APU_NUMERATOR_NTSC;
-	static uint32		ratio_denominator = APU_DENOMINATOR_NTSC;
-}
+static const int32	timing_hack_numerator = SNES_SPC::tempo_unit;
 
 static void EightBitize (uint8 *, int);
 static void DeStereo (uint8 *, int);
@@ -292,7 +260,6 @@ static void ReverseStereo (uint8 *src_buffer, int sample_count)
 
 bool8 S9xMixSamples (uint8 *buffer, int sample_count)
 {
-	static int	shrink_buffer_size = -1;
 	uint8		*dest;
 
 	if (!Settings.SixteenBitSound || !Settings.Stereo)
@@ -302,14 +269,14 @@ bool8 S9xMixSamples (uint8 *buffer, int sample_count)
 			sample_count <<= 1;
 
 		/* We still have to generate 16-bit samples for bit-dropping, too */
-		if (shrink_buffer_size < (sample_count << 1))
+		if (APU.shrink_buffer_size < (sample_count << 1))
 		{
-			delete[] spc::shrink_buffer;
-			spc::shrink_buffer = new uint8[sample_count << 1];
-			shrink_buffer_size = sample_count << 1;
+			delete[] APU.shrink_buffer;
+			APU.shrink_buffer = new uint8[sample_count << 1];
+			APU.shrink_buffer_size = sample_count << 1;
 		}
 
-		dest = spc::shrink_buffer;
+		dest = APU.shrink_buffer;
 	}
 	else
 		dest = buffer;
@@ -317,23 +284,23 @@ bool8 S9xMixSamples (uint8 *buffer, int sample_count)
 	if (Settings.Mute)
 	{
 		memset(dest, 0, sample_count << 1);
-		spc::resampler->clear();
+		APU.resampler->clear();
 
 		return (FALSE);
 	}
 	else
 	{
-		if (spc::resampler->avail() >= (sample_count + spc::lag))
+		if (APU.resampler->avail() >= (sample_count + APU.lag))
 		{
-			spc::resampler->read((short *) dest, sample_count);
-			if (spc::lag == spc::lag_master)
-				spc::lag = 0;
+			APU.resampler->read((short *) dest, sample_count);
+			if (APU.lag == APU.lag_master)
+				APU.lag = 0;
 		}
 		else
 		{
 			memset(buffer, (Settings.SixteenBitSound ? 0 : 128), (sample_count << (Settings.SixteenBitSound ? 1 : 0)) >> (Settings.Stereo ? 0 : 1));
-			if (spc::lag == 0)
-				spc::lag = spc::lag_master;
+			if (APU.lag == 0)
+				APU.lag = APU.lag_master;
 
 			return (FALSE);
 		}
@@ -361,17 +328,56 @@ bool8 S9xMixSamples (uint8 *buffer, int sample_count)
 
 int S9xGetSampleCount (void)
 {
-	return (spc::resampler->avail() >> (Settings.Stereo ? 0 : 1));
+	return (APU.resampler->avail() >> (Settings.Stereo ? 0 : 1));
 }
 
 void S9xFinalizeSamples (void)
 {
+#ifndef SNSFOPT_REMOVED
+	if (S9xIsSoundOutputDirect())
+	{
+		/* The DSP already runs at the playback rate, so the landing buffer
+		   goes to the output as it is. The output and the sync still follow
+		   the resampler path: it holds back the last stereo sample until the
+		   next push, and its fill level decides when samples are landed. */
+		int	sample_count = spc_core->sample_count();
+		int	capacity = APU.buffer_size >> (Settings.SoundSync ? 0 : 1);
+
+		if (APU.direct_filled + sample_count > capacity)
+		{
+			/* We weren't able to process the entire buffer. Potential overrun. */
+			APU.sound_in_sync = FALSE;
+
+			if (Settings.SoundSync && !Settings.TurboMode)
+				return;
+		}
+		else
+		if (sample_count != 0)
+		{
+			if (APU.direct_filled != 0)
+				APU.sound_output->write(APU.direct_held, sizeof(APU.direct_held));
+			APU.sound_output->write(APU.landing_buffer, (sample_count - 2) << 1);
+			memcpy(APU.direct_held, APU.landing_buffer + ((sample_count - 2) << 1), sizeof(APU.direct_held));
+
+			APU.direct_filled += sample_count;
+		}
+
+		if (!Settings.SoundSync || Settings.TurboMode)
+			APU.sound_in_sync = TRUE;
+		else
+			APU.sound_in_sync = (capacity - APU.direct_filled >= APU.direct_filled);
+
+		spc_core->set_output((SNES_SPC::sample_t *) APU.landing_buffer, APU.buffer_size >> 1);
+		return;
+	}
+#endif
+
 	if (!Settings.Mute)
 	{
-		if (!spc::resampler->push((short *) spc::landing_buffer, spc_core->sample_count()))
+		if (!APU.resampler->push((short *) APU.landing_buffer, spc_core->sample_count()))
 		{
 			/* We weren't able to process the entire buffer. Potential overrun. */
-			spc::sound_in_sync = FALSE;
+			APU.sound_in_sync = FALSE;
 
 			if (Settings.SoundSync && !Settings.TurboMode)
 				return;
@@ -379,53 +385,82 @@ void S9xFinalizeSamples (void)
 	}
 
 	if (!Settings.SoundSync || Settings.TurboMode || Settings.Mute)
-		spc::sound_in_sync = TRUE;
+		APU.sound_in_sync = TRUE;
 	else
-	if (spc::resampler->space_empty() >= spc::resampler->space_filled())
-		spc::sound_in_sync = TRUE;
+	if (APU.resampler->space_empty() >= APU.resampler->space_filled())
+		APU.sound_in_sync = TRUE;
 	else
-		spc::sound_in_sync = FALSE;
+		APU.sound_in_sync = FALSE;
 
-	spc_core->set_output((SNES_SPC::sample_t *) spc::landing_buffer, spc::buffer_size >> 1);
+	spc_core->set_output((SNES_SPC::sample_t *) APU.landing_buffer, APU.buffer_size >> 1);
 }
 
 void S9xLandSamples (void)
 {
-	if (spc::sa_callback != NULL)
-		spc::sa_callback(spc::extra_data);
+	if (APU.sa_callback != NULL)
+		APU.sa_callback(APU.extra_data);
 	else
 		S9xFinalizeSamples();
 }
 
 void S9xClearSamples (void)
 {
-	spc::resampler->clear();
-	spc::lag = spc::lag_master;
+	APU.resampler->clear();
+#ifndef SNSFOPT_REMOVED
+	APU.direct_filled = 0;
+#endif
+	APU.lag = APU.lag_master;
 }
 
 bool8 S9xSyncSound (void)
 {
-	if (!Settings.SoundSync || spc::sound_in_sync)
+	if (!Settings.SoundSync || APU.sound_in_sync)
 		return (TRUE);
 
 	S9xLandSamples();
 
-	return (spc::sound_in_sync);
+	return (APU.sound_in_sync);
 }
 
 void S9xSetSamplesAvailableCallback (apu_callback callback, void *data)
 {
-	spc::sa_callback = callback;
-	spc::extra_data  = data;
+	APU.sa_callback = callback;
+	APU.extra_data  = data;
+}
+
+#ifndef SNSFOPT_REMOVED
+void S9xSetSoundOutput (SNESSoundOut *output)
+{
+	APU.sound_output = output;
+}
+
+bool8 S9xIsSoundOutputDirect (void)
+{
+	/* Bypass the resampler when it would only copy samples around */
+	return (APU.sound_output != NULL && APU.native_rate && !Settings.Mute && Settings.Stereo && Settings.SixteenBitSound && !Settings.ReverseStereo);
+}
+
+/* Where the resampler path reads the frame's samples, the direct path has
+   written them already. Only the held back stereo sample stays queued. */
+void S9xEndSoundFrame (void)
+{
+	if (APU.direct_filled != 0)
+		APU.direct_filled = 2;
 }
+#endif
 
 static void UpdatePlaybackRate (void)
 {
 	if (Settings.SoundInputRate == 0)
 		Settings.SoundInputRate = APU_DEFAULT_INPUT_RATE;
 
-	double time_ratio = (double) Settings.SoundInputRate * spc::timing_hack_numerator / (Settings.SoundPlaybackRate * spc::timing_hack_denominator);
-	spc::resampler->time_ratio(time_ratio);
+	double time_ratio = (double) Settings.SoundInputRate * timing_hack_numerator / (Settings.SoundPlaybackRate * APU.timing_hack_denominator);
+	APU.resampler->time_ratio(time_ratio);
+
+#ifndef SNSFOPT_REMOVED
+	APU.native_rate = ((int64) Settings.SoundInputRate * timing_hack_numerator == (int64) Settings.SoundPlaybackRate * APU.timing_hack_denominator);
+	APU.direct_filled = 0;
+#endif
 }
 
 bool8 S9xInitSound (int buffer_ms, int lag_ms)
@@ -436,51 +471,51 @@ bool8 S9xInitSound (int buffer_ms, int lag_ms)
 	int	sample_count     = buffer_ms * 32000 / 1000;
 	int	lag_sample_count = lag_ms    * 32000 / 1000;
 
-	spc::lag_master = lag_sample_count;
+	APU.lag_master = lag_sample_count;
 	if (Settings.Stereo)
-		spc::lag_master <<= 1;
-	spc::lag = spc::lag_master;
+		APU.lag_master <<= 1;
+	APU.lag = APU.lag_master;
 
 	if (sample_count < APU_MINIMUM_SAMPLE_COUNT)
 		sample_count = APU_MINIMUM_SAMPLE_COUNT;
 
-	spc::buffer_size = sample_count;
+	APU.buffer_size = sample_count;
 	if (Settings.Stereo)
-		spc::buffer_size <<= 1;
+		APU.buffer_size <<= 1;
 	if (Settings.SixteenBitSound)
-		spc::buffer_size <<= 1;
+		APU.buffer_size <<= 1;
 
 #ifdef SNSFOPT_REMOVED
-	printf("Sound buffer size: %d (%d samples)\n", spc::buffer_size, sample_count);
+	printf("Sound buffer size: %d (%d samples)\n", APU.buffer_size, sample_count);
 #endif
 
-	if (spc::landing_buffer)
-		delete[] spc::landing_buffer;
-	spc::landing_buffer = new uint8[spc::buffer_size * 2];
-	if (!spc::landing_buffer)
+	if (APU.landing_buffer)
+		delete[] APU.landing_buffer;
+	APU.landing_buffer = new uint8[APU.buffer_size * 2];
+	if (!APU.landing_buffer)
 		return (FALSE);
 
 	/* The resampler and spc unit use samples (16-bit short) as
 	   arguments. Use 2x in the resampler for buffer leveling with SoundSync */
-	if (!spc::resampler)
+	if (!APU.resampler)
 	{
-		spc::resampler = new APU_DEFAULT_RESAMPLER(spc::buffer_size >> (Settings.SoundSync ? 0 : 1));
-		if (!spc::resampler)
+		APU.resampler = new APU_DEFAULT_RESAMPLER(APU.buffer_size >> (Settings.SoundSync ? 0 : 1));
+		if (!APU.resampler)
 		{
-			delete[] spc::landing_buffer;
+			delete[] APU.landing_buffer;
 			return (FALSE);
 		}
 	}
 	else
-		spc::resampler->resize(spc::buffer_size >> (Settings.SoundSync ? 0 : 1));
+		APU.resampler->resize(APU.buffer_size >> (Settings.SoundSync ? 0 : 1));
 
-	spc_core->set_output((SNES_SPC::sample_t *) spc::landing_buffer, spc::buffer_size >> 1);
+	spc_core->set_output((SNES_SPC::sample_t *) APU.landing_buffer, APU.buffer_size >> 1);
 
 	UpdatePlaybackRate();
 
-	spc::sound_enabled = S9xOpenSoundDevice();
+	APU.sound_enabled = S9xOpenSoundDevice();
 
-	return (spc::sound_enabled);
+	return (APU.sound_enabled);
 }
 
 void S9xSetSoundControl (uint8 voice_switch)
@@ -491,7 +526,7 @@ void S9xSetSoundControl (uint8 voice_switch)
 void S9xSetSoundMute (bool8 mute)
 {
 	Settings.Mute = mute;
-	if (!spc::sound_enabled)
+	if (!APU.sound_enabled)
 		Settings.Mute = TRUE;
 }
 
@@ -502,13 +537,41 @@ void S9xDumpSPCSnapshot (void)
 #endif
 
 #ifndef SNSFOPT_REMOVED
-	if (S9xTakingSPCSnapshot == FALSE && S9xLastSPCSnapshot == NULL) {
+	if (S9xTakingSPCSnapshot == FALSE && S9xSPCSnapshots.empty()) {
 		S9xTakingSPCSnapshot = TRUE;
+		APU.SPCSnapshotKeyOns->clear();
 		spc_core->dsp_dump_spc_snapshot();
 	}
 #endif
 }
 
+#ifndef SNSFOPT_REMOVED
+// Takes a snapshot at each of the given key-ons, counted from 1 as the KON
+// writes that reach the DSP from now on, in ascending order
+void S9xDumpSPCSnapshotsAtKeyOns (const int *key_ons, int count)
+{
+	if (S9xTakingSPCSnapshot != FALSE || count <= 0)
+		return;
+
+	APU.SPCSnapshotKeyOns->clear();
+	for (int i = count - 1; i > 0; i--)
+		APU.SPCSnapshotKeyOns->push_back(key_ons[i] - key_ons[i - 1]);
+
+	S9xTakingSPCSnapshot = TRUE;
+	spc_core->dsp_dump_spc_snapshot(key_ons[0]);
+}
+
+SPCFile * S9xPopSPCSnapshot (void)
+{
+	if (S9xSPCSnapshots.empty())
+		return (NULL);
+
+	SPCFile	*spc_file = S9xSPCSnapshots.front();
+	S9xSPCSnapshots.erase(S9xSPCSnapshots.begin());
+	return (spc_file);
+}
+#endif
+
 static void SPCSnapshotCallback (void)
 {
 #ifdef SNSF9X_REMOVED
@@ -517,8 +580,48 @@ static void SPCSnapshotCallback (void)
 #endif
 
 #ifndef SNSFOPT_REMOVED
-	S9xLastSPCSnapshot = S9xSPCDump();
-	S9xTakingSPCSnapshot = FALSE;
+	SPCFile	*spc_file = S9xSPCDump();
+	if (spc_file)
+		S9xSPCSnapshots.push_back(spc_file);
+
+	if (APU.SPCSnapshotKeyOns->empty())
+		S9xTakingSPCSnapshot = FALSE;
+	else
+	{
+		spc_core->dsp_dump_spc_snapshot(APU.SPCSnapshotKeyOns->back());
+		APU.SPCSnapshotKeyOns->pop_back();
+	}
+#endif
+}
+
+void S9xInitAPUContext (struct SAPU *apu)
+{
+	memset(apu, 0, sizeof(struct SAPU));
+
+	apu->sound_in_sync = TRUE;
+	apu->sound_enabled = FALSE;
+
+	apu->shrink_buffer_size = -1;
+
+	apu->timing_hack_denominator = SNES_SPC::tempo_unit;
+	/* Set these to NTSC for now. Will change to PAL in S9xAPUTimingSetSpeedup
+	   if necessary on game load. */
+	apu->ratio_numerator = APU_NUMERATOR_NTSC;
+	apu->ratio_denominator = APU_DENOMINATOR_NTSC;
+
+#ifndef SNSFOPT_REMOVED
+	apu->SPCSnapshots = NULL;
+	apu->SPCSnapshotKeyOns = NULL;
+	apu->SPCSnapshotCount = 0;
+	apu->TakingSPCSnapshot = FALSE;
+	apu->AccurateDSPReset = TRUE;
+	apu->CoverageOnlyDSP = FALSE;
+
+	apu->sound_output = NULL;
+	apu->native_rate = FALSE;
+	apu->direct_filled = 0;
+
+	apu->log = NULL;
 #endif
 }
 
@@ -530,6 +633,7 @@ bool8 S9xInitAPU (void)
 
 #ifndef SNSFOPT_REMOVED
 	spc_core->init((S9xAccurateDSPReset != FALSE) ? true : false);
+	spc_core->dsp_set_coverage_only((S9xCoverageOnlyDSP != FALSE) ? true : false);
 #else
 	spc_core->init();
 #endif
@@ -537,9 +641,14 @@ bool8 S9xInitAPU (void)
 
 	spc_core->dsp_set_spc_snapshot_callback(SPCSnapshotCallback);
 
-	spc::landing_buffer = NULL;
-	spc::shrink_buffer  = NULL;
-	spc::resampler      = NULL;
+#ifndef SNSFOPT_REMOVED
+	APU.SPCSnapshots = new std::vector<SPCFile *>;
+	APU.SPCSnapshotKeyOns = new std::vector<int>;
+#endif
+
+	APU.landing_buffer = NULL;
+	APU.shrink_buffer  = NULL;
+	APU.resampler      = NULL;
 
 	S9xTakingSPCSnapshot = FALSE;
 
@@ -554,62 +663,107 @@ void S9xDeinitAPU (void)
 		spc_core = NULL;
 	}
 
-	if (spc::resampler)
+	if (APU.resampler)
 	{
-		delete spc::resampler;
-		spc::resampler = NULL;
+		delete APU.resampler;
+		APU.resampler = NULL;
 	}
 
-	if (spc::landing_buffer)
+	if (APU.landing_buffer)
 	{
-		delete[] spc::landing_buffer;
-		spc::landing_buffer = NULL;
+		delete[] APU.landing_buffer;
+		APU.landing_buffer = NULL;
 	}
 
-	if (spc::shrink_buffer)
+	if (APU.shrink_buffer)
 	{
-		delete[] spc::shrink_buffer;
-		spc::shrink_buffer = NULL;
+		delete[] APU.shrink_buffer;
+		APU.shrink_buffer = NULL;
+		APU.shrink_buffer_size = -1;
 	}
 
 #ifndef SNSFOPT_REMOVED
-	delete S9xLastSPCSnapshot;
+	if (APU.SPCSnapshots)
+	{
+		for (size_t i = 0; i < S9xSPCSnapshots.size(); i++)
+			delete S9xSPCSnapshots[i];
+		delete APU.SPCSnapshots;
+		APU.SPCSnapshots = NULL;
+	}
+
+	delete APU.SPCSnapshotKeyOns;
+	APU.SPCSnapshotKeyOns = NULL;
 #endif
 }
 
 static inline int S9xAPUGetClock (int32 cpucycles)
 {
-	return (spc::ratio_numerator * (cpucycles - spc::reference_time) + spc::remainder) /
-			spc::ratio_denominator;
+	return (APU.ratio_numerator * (cpucycles - APU.reference_time) + APU.remainder) /
+			APU.ratio_denominator;
 }
 
 static inline int S9xAPUGetClockRemainder (int32 cpucycles)
 {
-	return (spc::ratio_numerator * (cpucycles - spc::reference_time) + spc::remainder) %
-			spc::ratio_denominator;
+	return (APU.ratio_numerator * (cpucycles - APU.reference_time) + APU.remainder) %
+			APU.ratio_denominator;
 }
 
 uint8 S9xAPUReadPort (int port)
 {
+#ifndef SNSFOPT_REMOVED
+	// values read ahead by the idle loop skip (see S9xIdleLoopCheck)
+	if (CPU.IdleLoopPortQueueLength)
+	{
+		uint8	byte = CPU.IdleLoopPortQueue[CPU.IdleLoopPortQueuePos++];
+		if (CPU.IdleLoopPortQueuePos == CPU.IdleLoopPortQueueLength)
+			CPU.IdleLoopPortQueueLength = CPU.IdleLoopPortQueuePos = 0;
+		return (byte);
+	}
+#endif
+
 	return ((uint8) spc_core->read_port(S9xAPUGetClock(CPU.Cycles), port));
 }
 
+#ifndef SNSFOPT_REMOVED
+static void S9xAPULogEvent (uint8 event, int clock, int size)
+{
+	size_t	pos = APU.log->size();
+
+	APU.log->resize(pos + 1 + size);
+	(*APU.log)[pos] = event;
+	if (size >= 4)
+		SET_LE32(&(*APU.log)[pos + 1], clock);
+}
+#endif
+
 void S9xAPUWritePort (int port, uint8 byte)
 {
+#ifndef SNSFOPT_REMOVED
+	if (APU.log)
+	{
+		S9xAPULogEvent(APU_LOG_WRITE_PORT + port, S9xAPUGetClock(CPU.Cycles), 5);
+		APU.log->back() = byte;
+	}
+#endif
+
 	spc_core->write_port(S9xAPUGetClock(CPU.Cycles), port, byte);
 }
 
 void S9xAPUSetReferenceTime (int32 cpucycles)
 {
-	spc::reference_time = cpucycles;
+	APU.reference_time = cpucycles;
 }
 
 void S9xAPUExecute (void)
 {
 	/* Accumulate partial APU cycles */
+#ifndef SNSFOPT_REMOVED
+	if (APU.log)
+		S9xAPULogEvent(APU_LOG_EXECUTE, S9xAPUGetClock(CPU.Cycles), 4);
+#endif
 	spc_core->end_frame(S9xAPUGetClock(CPU.Cycles));
 
-	spc::remainder = S9xAPUGetClockRemainder(CPU.Cycles);
+	APU.remainder = S9xAPUGetClockRemainder(CPU.Cycles);
 
 	S9xAPUSetReferenceTime(CPU.Cycles);
 }
@@ -618,8 +772,14 @@ void S9xAPUEndScanline (void)
 {
 	S9xAPUExecute();
 
-	if (spc_core->sample_count() >= APU_MINIMUM_SAMPLE_BLOCK || !spc::sound_in_sync)
+	if (spc_core->sample_count() >= APU_MINIMUM_SAMPLE_BLOCK || !APU.sound_in_sync)
+	{
+	#ifndef SNSFOPT_REMOVED
+		if (APU.log)
+			S9xAPULogEvent(APU_LOG_LAND_SAMPLES, 0, 0);
+	#endif
 		S9xLandSamples();
+	}
 }
 
 void S9xAPUTimingSetSpeedup (int ticks)
@@ -627,12 +787,12 @@ void S9xAPUTimingSetSpeedup (int ticks)
 	if (ticks != 0)
 		printf("APU speedup hack: %d\n", ticks);
 
-	spc::timing_hack_denominator = SNES_SPC::tempo_unit - ticks;
-	spc_core->set_tempo(spc::timing_hack_denominator);
+	APU.timing_hack_denominator = SNES_SPC::tempo_unit - ticks;
+	spc_core->set_tempo(APU.timing_hack_denominator);
 
-	spc::ratio_numerator = Settings.PAL ? APU_NUMERATOR_PAL : APU_NUMERATOR_NTSC;
-	spc::ratio_denominator = Settings.PAL ? APU_DENOMINATOR_PAL : APU_DENOMINATOR_NTSC;
-	spc::ratio_denominator = spc::ratio_denominator * spc::timing_hack_denominator / spc::timing_hack_numerator;
+	APU.ratio_numerator = Settings.PAL ? APU_NUMERATOR_PAL : APU_NUMERATOR_NTSC;
+	APU.ratio_denominator = Settings.PAL ? APU_DENOMINATOR_PAL : APU_DENOMINATOR_NTSC;
+	APU.ratio_denominator = APU.ratio_denominator * APU.timing_hack_denominator / timing_hack_numerator;
 
 	UpdatePlaybackRate();
 
@@ -640,22 +800,32 @@ void S9xAPUTimingSetSpeedup (int ticks)
 
 void S9xResetAPU (void)
 {
-	spc::reference_time = 0;
-	spc::remainder = 0;
+	APU.reference_time = 0;
+	APU.remainder = 0;
 	spc_core->reset();
-	spc_core->set_output((SNES_SPC::sample_t *) spc::landing_buffer, spc::buffer_size >> 1);
+	spc_core->set_output((SNES_SPC::sample_t *) APU.landing_buffer, APU.buffer_size >> 1);
+
+	APU.resampler->clear();
 
-	spc::resampler->clear();
+#ifndef SNSFOPT_REMOVED
+	APU.direct_filled = 0;
+	APU.SPCSnapshotCount = 0;
+#endif
 }
 
 void S9xSoftResetAPU (void)
 {
-	spc::reference_time = 0;
-	spc::remainder = 0;
+	APU.reference_time = 0;
+	APU.remainder = 0;
 	spc_core->soft_reset();
-	spc_core->set_output((SNES_SPC::sample_t *) spc::landing_buffer, spc::buffer_size >> 1);
+	spc_core->set_output((SNES_SPC::sample_t *) APU.landing_buffer, APU.buffer_size >> 1);
+
+	APU.resampler->clear();
 
-	spc::resampler->clear();
+#ifndef SNSFOPT_REMOVED
+	APU.direct_filled = 0;
+	APU.SPCSnapshotCount = 0;
+#endif
 }
 
 static void from_apu_to_state (uint8 **buf, void *var, size_t size)
@@ -676,9 +846,9 @@ void S9xAPUSaveState (uint8 *block)
 
 	spc_core->copy_state(&ptr, from_apu_to_state);
 
-	SET_LE32(ptr, spc::reference_time);
+	SET_LE32(ptr, APU.reference_time);
 	ptr += sizeof(int32);
-	SET_LE32(ptr, spc::remainder);
+	SET_LE32(ptr, APU.remainder);
 }
 
 void S9xAPULoadState (uint8 *block)
@@ -689,13 +859,67 @@ void S9xAPULoadState (uint8 *block)
 
 	spc_core->copy_state(&ptr, to_apu_from_state);
 
-	spc::reference_time = GET_LE32(ptr);
+	APU.reference_time = GET_LE32(ptr);
 	ptr += sizeof(int32);
-	spc::remainder = GET_LE32(ptr);
+	APU.remainder = GET_LE32(ptr);
 }
 
 #ifndef SNSFOPT_REMOVED
 
+// Unlike S9xAPUSaveState(), this keeps everything that affects the following
+// output, such as coverage, samples waiting in the landing buffer and the
+// resampler history or the sample held back by the direct output. The state can
+// only be loaded by the same build.
+
+// Bump it whenever the layout of the state below changes
+#define APU_FREEZE_VERSION	3
+
+uint32 S9xAPUFreezeVersion (void)
+{
+	return (APU_FREEZE_VERSION);
+}
+
+uint32 S9xAPUFreezeSize (void)
+{
+	return (spc_core->raw_state_size() + APU.buffer_size +
+		sizeof(APU.reference_time) + sizeof(APU.remainder) + sizeof(APU.sound_in_sync) +
+		sizeof(APU.direct_filled) + sizeof(APU.direct_held) + APU.resampler->state_size());
+}
+
+void S9xAPUFreeze (uint8 *block)
+{
+	uint8	*ptr = block;
+
+	spc_core->save_raw_state(ptr);
+	ptr += spc_core->raw_state_size();
+
+	from_apu_to_state(&ptr, APU.landing_buffer, APU.buffer_size);
+	from_apu_to_state(&ptr, &APU.reference_time, sizeof(APU.reference_time));
+	from_apu_to_state(&ptr, &APU.remainder, sizeof(APU.remainder));
+	from_apu_to_state(&ptr, &APU.sound_in_sync, sizeof(APU.sound_in_sync));
+	from_apu_to_state(&ptr, &APU.direct_filled, sizeof(APU.direct_filled));
+	from_apu_to_state(&ptr, APU.direct_held, sizeof(APU.direct_held));
+
+	APU.resampler->save_state(ptr);
+}
+
+void S9xAPUUnfreeze (uint8 *block)
+{
+	uint8	*ptr = block;
+
+	spc_core->load_raw_state(ptr);
+	ptr += spc_core->raw_state_size();
+
+	to_apu_from_state(&ptr, APU.landing_buffer, APU.buffer_size);
+	to_apu_from_state(&ptr, &APU.reference_time, sizeof(APU.reference_time));
+	to_apu_from_state(&ptr, &APU.remainder, sizeof(APU.remainder));
+	to_apu_from_state(&ptr, &APU.sound_in_sync, sizeof(APU.sound_in_sync));
+	to_apu_from_state(&ptr, &APU.direct_filled, sizeof(APU.direct_filled));
+	to_apu_from_state(&ptr, APU.direct_held, sizeof(APU.direct_held));
+
+	APU.resampler->load_state(ptr);
+}
+
 SPCFile * S9xSPCDump (void)
 {
 	const size_t SPC_FILE_SIZE = 0x10200;
@@ -707,7 +931,94 @@ SPCFile * S9xSPCDump (void)
 	spc_core->save_spc(&spc_data);
 
 	SPCFile * spc_file = SPCFile::Load(spc_data, SPC_FILE_SIZE);
+
+	// see what the song uses from the first snapshot on
+	if (APU.SPCSnapshotCount++ == 0)
+		spc_core->reset_ram_access();
+
 	return spc_file;
 }
 
+// Replaces the whole APU state with an SPC file image. Returns FALSE if the
+// image is not a valid SPC file.
+bool8 S9xAPULoadSPC (const uint8 *data, int32 size)
+{
+	S9xResetAPU();
+
+	if (spc_core->load_spc(data, size))
+		return (FALSE);
+
+	spc_core->set_output((SNES_SPC::sample_t *) APU.landing_buffer, APU.buffer_size >> 1);
+	return (TRUE);
+}
+
+// Runs the APU alone for one NTSC frame, scanline by scanline, as if the
+// 65c816 never touched the ports.
+void S9xAPURunFrame (void)
+{
+	for (int line = 0; line < SNES_MAX_NTSC_VCOUNTER; line++)
+	{
+		uint32	clocks = APU.ratio_numerator * SNES_CYCLES_PER_SCANLINE + APU.remainder;
+
+		spc_core->end_frame(clocks / APU.ratio_denominator);
+		APU.remainder = clocks % APU.ratio_denominator;
+
+		if (spc_core->sample_count() >= APU_MINIMUM_SAMPLE_BLOCK || !APU.sound_in_sync)
+			S9xLandSamples();
+	}
+}
+
+void S9xSetAPULog (std::vector<uint8> *log)
+{
+	APU.log = log;
+}
+
+void S9xAPULogEndFrame (void)
+{
+	if (APU.log)
+		S9xAPULogEvent(APU_LOG_END_FRAME, 0, 0);
+}
+
+// Replays one frame of an APU log from *pos. The APU has to be in the state
+// it had when the log reached *pos. Returns FALSE at the end of the log.
+bool8 S9xReplayAPUFrame (const uint8 *log, size_t size, size_t *pos)
+{
+	size_t	i = *pos;
+
+	while (i < size)
+	{
+		uint8	event = log[i++];
+
+		if (event < APU_LOG_EXECUTE)
+		{
+			if (i + 5 > size)
+				break;
+			spc_core->write_port(GET_LE32(&log[i]), event - APU_LOG_WRITE_PORT, log[i + 4]);
+			i += 5;
+		}
+		else
+		if (event == APU_LOG_EXECUTE)
+		{
+			if (i + 4 > size)
+				break;
+			spc_core->end_frame(GET_LE32(&log[i]));
+			i += 4;
+		}
+		else
+		if (event == APU_LOG_LAND_SAMPLES)
+			S9xLandSamples();
+		else
+		if (event == APU_LOG_END_FRAME)
+		{
+			*pos = i;
+			return (TRUE);
+		}
+		else
+			break;
+	}
+
+	*pos = size;
+	return (FALSE);
+}
+
 #endif
@@ -182,13 +182,73 @@
 #include "SNES_SPC.h"
 
 #ifndef SNSFOPT_REMOVED
+#include <vector>
 #include "../../SPCFile.h"
+
+struct SNESSoundOut;
+
+// APU log: everything the 65c816 does to the APU, so the APU alone can
+// produce the same output again (see S9xReplayAPUFrame)
+enum
+{
+	APU_LOG_WRITE_PORT = 0,		// + port, then clock (LE32) and byte
+	APU_LOG_EXECUTE = 4,		// then clock (LE32)
+	APU_LOG_LAND_SAMPLES,
+	APU_LOG_END_FRAME
+};
 #endif
 
 typedef void (*apu_callback) (void *);
 
+class Resampler;
+
+struct SAPU
+{
+	SNES_SPC	*core;
+
+	apu_callback	sa_callback;
+	void			*extra_data;
+
+	bool8		sound_in_sync;
+	bool8		sound_enabled;
+
+	int			buffer_size;
+	int			lag_master;
+	int			lag;
+
+	uint8		*landing_buffer;
+	uint8		*shrink_buffer;
+	int			shrink_buffer_size;
+
+	Resampler	*resampler;
+
+	int32		reference_time;
+	uint32		remainder;
+
+	int32		timing_hack_denominator;
+	uint32		ratio_numerator;
+	uint32		ratio_denominator;
+
+#ifndef SNSFOPT_REMOVED
+	std::vector<SPCFile *>	*SPCSnapshots;	// taken and not popped yet, oldest first
+	std::vector<int>	*SPCSnapshotKeyOns;	// key-ons between the remaining snapshots, last first
+	int			SPCSnapshotCount;	// taken since reset
+	bool8		TakingSPCSnapshot;
+	bool8		AccurateDSPReset;
+	bool8		CoverageOnlyDSP;
+
+	SNESSoundOut	*sound_output;
+	bool8		native_rate;
+	int32		direct_filled;	// samples the resampler would hold in the direct path
+	int16		direct_held[2];	// last stereo sample, held back as the resampler does
+
+	std::vector<uint8>	*log;
+#endif
+};
+
 #define SPC_SAVE_STATE_BLOCK_SIZE	(SNES_SPC::state_size + 8)
 
+void S9xInitAPUContext (struct SAPU *);
 bool8 S9xInitAPU (void);
 void S9xDeinitAPU (void);
 void S9xResetAPU (void);
@@ -203,13 +263,18 @@ void S9xAPULoadState (uint8 *);
 void S9xAPUSaveState (uint8 *);
 void S9xDumpSPCSnapshot (void);
 #ifndef SNSFOPT_REMOVED
+void S9xDumpSPCSnapshotsAtKeyOns (const int *, int);
+SPCFile * S9xPopSPCSnapshot (void);
+uint32 S9xAPUFreezeVersion (void);
+uint32 S9xAPUFreezeSize (void);
+void S9xAPUFreeze (uint8 *);
+void S9xAPUUnfreeze (uint8 *);
 SPCFile * S9xSPCDump (void);
-
-START_EXTERN_C
-extern SPCFile * S9xLastSPCSnapshot;
-extern bool8 S9xTakingSPCSnapshot;
-extern bool8 S9xAccurateDSPReset;
-END_EXTERN_C
+void S9xSetAPULog (std::vector<uint8> *);
+void S9xAPULogEndFrame (void);
+bool8 S9xReplayAPUFrame (const uint8 *, size_t, size_t *);
+bool8 S9xAPULoadSPC (const uint8 *, int32);
+void S9xAPURunFrame (void);
 #endif
 
 bool8 S9xInitSound (int, int);
@@ -224,7 +289,22 @@ void S9xFinalizeSamples (void);
 void S9xClearSamples (void);
 bool8 S9xMixSamples (uint8 *, int);
 void S9xSetSamplesAvailableCallback (apu_callback, void *);
+#ifndef SNSFOPT_REMOVED
+void S9xSetSoundOutput (SNESSoundOut *);
+bool8 S9xIsSoundOutputDirect (void);
+void S9xEndSoundFrame (void);
+#endif
+
+extern THREAD_LOCAL struct SAPU	*S9xAPU;
+
+#define APU			(*S9xAPU)
+#define spc_core	(APU.core)
 
-extern SNES_SPC	*spc_core;
+#ifndef SNSFOPT_REMOVED
+#define S9xSPCSnapshots			(*APU.SPCSnapshots)
+#define S9xTakingSPCSnapshot	(APU.TakingSPCSnapshot)
+#define S9xAccurateDSPReset		(APU.AccurateDSPReset)
+#define S9xCoverageOnlyDSP		(APU.CoverageOnlyDSP)
+#endif
 
 #endif
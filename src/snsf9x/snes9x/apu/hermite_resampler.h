@@ -139,6 +139,36 @@ class HermiteResampler : public Resampler
         {
             return (int) floor (((size >> 2) - r_frac) / r_step) * 2;
         }
+
+        int
+        state_size (void)
+        {
+            return Resampler::state_size () + sizeof (r_frac) + sizeof (r_left) + sizeof (r_right);
+        }
+
+        unsigned char *
+        save_state (unsigned char *dst)
+        {
+            dst = Resampler::save_state (dst);
+            memcpy (dst, &r_frac, sizeof (r_frac));
+            dst += sizeof (r_frac);
+            memcpy (dst, r_left, sizeof (r_left));
+            dst += sizeof (r_left);
+            memcpy (dst, r_right, sizeof (r_right));
+            return dst + sizeof (r_right);
+        }
+
+        const unsigned char *
+        load_state (const unsigned char *src)
+        {
+            src = Resampler::load_state (src);
+            memcpy (&r_frac, src, sizeof (r_frac));
+            src += sizeof (r_frac);
+            memcpy (r_left, src, sizeof (r_left));
+            src += sizeof (r_left);
+            memcpy (r_right, src, sizeof (r_right));
+            return src + sizeof (r_right);
+        }
 };
 
 #endif /* __HERMITE_RESAMPLER_H */
@@ -110,6 +110,36 @@ class LinearResampler : public Resampler
         {
             return (((size >> 2) * f__inv_r_step) - ((f__r_frac * f__inv_r_step) >> f_prec)) >> (f_prec - 1);
         }
+
+        int
+        state_size (void)
+        {
+            return Resampler::state_size () + sizeof (f__r_frac) + sizeof (r_left) + sizeof (r_right);
+        }
+
+        unsigned char *
+        save_state (unsigned char *dst)
+        {
+            dst = Resampler::save_state (dst);
+            memcpy (dst, &f__r_frac, sizeof (f__r_frac));
+            dst += sizeof (f__r_frac);
+            memcpy (dst, &r_left, sizeof (r_left));
+            dst += sizeof (r_left);
+            memcpy (dst, &r_right, sizeof (r_right));
+            return dst + sizeof (r_right);
+        }
+
+        const unsigned char *
+        load_state (const unsigned char *src)
+        {
+            src = Resampler::load_state (src);
+            memcpy (&f__r_frac, src, sizeof (f__r_frac));
+            src += sizeof (f__r_frac);
+            memcpy (&r_left, src, sizeof (r_left));
+            src += sizeof (r_left);
+            memcpy (&r_right, src, sizeof (r_right));
+            return src + sizeof (r_right);
+        }
 };
 
 #endif /* __LINEAR_RESAMPLER_H */
@@ -55,6 +55,36 @@ class Resampler : public ring_buffer
         {
             ring_buffer::resize (num_samples << 1);
         }
+
+        /* Buffered samples and read position, for save states. Only valid
+           for a resampler of the same size and ratio. */
+        virtual int
+        state_size (void)
+        {
+            return sizeof (int) * 2 + buffer_size;
+        }
+
+        virtual unsigned char *
+        save_state (unsigned char *dst)
+        {
+            memcpy (dst, &size, sizeof (int));
+            dst += sizeof (int);
+            memcpy (dst, &start, sizeof (int));
+            dst += sizeof (int);
+            memcpy (dst, buffer, buffer_size);
+            return dst + buffer_size;
+        }
+
+        virtual const unsigned char *
+        load_state (const unsigned char *src)
+        {
+            memcpy (&size, src, sizeof (int));
+            src += sizeof (int);
+            memcpy (&start, src, sizeof (int));
+            src += sizeof (int);
+            memcpy (buffer, src, buffer_size);
+            return src + buffer_size;
+        }
 };
 
 #endif /* __RESAMPLER_H */
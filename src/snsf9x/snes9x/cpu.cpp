@@ -253,6 +253,15 @@ static void S9xSoftResetCPU (void)
 	CPU.PBPCAtOpcodeStart = 0xffffffff;
 	CPU.AutoSaveTimer = 0;
 	CPU.SRAMModified = FALSE;
+#ifndef SNSFOPT_REMOVED
+	CPU.IdleLoopPBPC = 0xffffffff;
+	CPU.IdleLoopCycles = 0;
+	CPU.IdleLoopTainted = TRUE;
+	CPU.IdleLoopReadCount = 0;
+	CPU.IdleLoopPortQueueLength = 0;
+	CPU.IdleLoopPortQueuePos = 0;
+	CPU.IdleLoopSkippedCycles = 0;
+#endif
 
 	Timings.InterlaceField = FALSE;
 	Timings.H_Max = Timings.H_Max_Master;
@@ -287,6 +296,7 @@ void S9xReset (void)
 	memset(Memory.ROMCoverage, 0x00, CMemory::MAX_ROM_SIZE);
 	memset(Memory.ROMCoverageHistogram, 0x00, sizeof(uint32) * 256);
 	Memory.ROMCoverageSize = 0;
+	Memory.ROMCoverageUpdates = 0;
 
 	for (uint32 offset = 0x7fb0; offset <= 0x7fff; offset++)
 	{
@@ -364,6 +364,165 @@ void S9xClearIRQ (uint32 source)
 #endif
 }
 
+#ifndef SNSFOPT_REMOVED
+// Idle loop skipping
+//
+// An iteration of a loop, from one taken backward branch (or WAI) to the next
+// at the same address, is measured. If it wrote nothing, ran no H event,
+// marked no new ROM coverage and left the CPU state as it found it, then every
+// following iteration does exactly the same until CPU.NextEvent, except for
+// what it reads from the APU ports and HVBJOY. Those reads are replayed at the
+// cycle they would happen in each iteration, and skipping stops at the first
+// iteration that would read something else, so that the interpreter runs it.
+// Unlike CPU_SHUTDOWN, no emulated cycle is lost or gained.
+
+static void S9xIdleLoopStart (void)
+{
+	CPU.IdleLoopPBPC = Registers.PBPC;
+	CPU.IdleLoopCycles = CPU.Cycles;
+	CPU.IdleLoopTainted = (CPU.Flags != 0);
+	CPU.IdleLoopCoverage = Memory.ROMCoverageUpdates;
+	CPU.IdleLoopRegisters = Registers;
+	CPU.IdleLoopFlags[0] = ICPU._Carry;
+	CPU.IdleLoopFlags[1] = ICPU._Zero;
+	CPU.IdleLoopFlags[2] = ICPU._Negative;
+	CPU.IdleLoopFlags[3] = ICPU._Overflow;
+	CPU.IdleLoopOpenBus = OpenBus;
+	CPU.IdleLoopWaiting = CPU.WaitingForInterrupt;
+	CPU.IdleLoopReadCount = 0;
+}
+
+static bool8 S9xIdleLoopRepeats (void)
+{
+	if (CPU.IdleLoopTainted || CPU.Flags || CPU.IdleLoopPortQueueLength)
+		return (FALSE);
+
+	if (Registers.PBPC != CPU.IdleLoopPBPC || Memory.ROMCoverageUpdates != CPU.IdleLoopCoverage)
+		return (FALSE);
+
+	struct SRegisters	&r = CPU.IdleLoopRegisters;
+
+	return (Registers.DB == r.DB && Registers.P.W == r.P.W && Registers.A.W == r.A.W &&
+			Registers.D.W == r.D.W && Registers.S.W == r.S.W && Registers.X.W == r.X.W && Registers.Y.W == r.Y.W &&
+			ICPU._Carry == CPU.IdleLoopFlags[0] && ICPU._Zero == CPU.IdleLoopFlags[1] &&
+			ICPU._Negative == CPU.IdleLoopFlags[2] && ICPU._Overflow == CPU.IdleLoopFlags[3] &&
+			OpenBus == CPU.IdleLoopOpenBus && CPU.WaitingForInterrupt == CPU.IdleLoopWaiting);
+}
+
+void S9xIdleLoopCheck (void)
+{
+	int32	length = CPU.Cycles - CPU.IdleLoopCycles;
+
+	if (length > 0 && S9xIdleLoopRepeats())
+	{
+		// no iteration may reach the next event, which is checked at the end of an access
+		int32	start = CPU.Cycles;
+		int32	count = (CPU.NextEvent - 1 - start) / length;
+		int32	i;
+
+		for (i = 0; i < count; i++)
+		{
+			int32	base = start + i * length;
+			int		n;
+
+			for (n = 0; n < CPU.IdleLoopReadCount; n++)
+			{
+				uint8	byte;
+
+				CPU.Cycles = base + CPU.IdleLoopReadCycles[n];
+				if (CPU.IdleLoopReadAddress[n] == 0x4212)
+					byte = REGISTER_4212();
+				else
+					byte = S9xAPUReadPort(CPU.IdleLoopReadAddress[n] & 3);
+
+				if (byte != CPU.IdleLoopReadValue[n])
+					break;
+			}
+
+			if (n < CPU.IdleLoopReadCount)
+			{
+				// The APU has already run up to this read, so the interpreter gets
+				// the port values of this iteration from the queue instead.
+				int	queued = 0;
+
+				for (int k = 0; k < n; k++)
+				{
+					if (CPU.IdleLoopReadAddress[k] != 0x4212)
+						CPU.IdleLoopPortQueue[queued++] = CPU.IdleLoopReadValue[k];
+				}
+
+				if (CPU.IdleLoopReadAddress[n] != 0x4212)
+					CPU.IdleLoopPortQueue[queued++] = S9xAPUReadPort(CPU.IdleLoopReadAddress[n] & 3);
+
+				CPU.IdleLoopPortQueueLength = queued;
+				CPU.IdleLoopPortQueuePos = 0;
+				break;
+			}
+		}
+
+		CPU.Cycles = start + i * length;
+		CPU.IdleLoopSkippedCycles += i * length;
+	}
+
+	S9xIdleLoopStart();
+}
+
+void S9xIdleLoopNoteRead (uint32 Address, uint8 byte)
+{
+	if (CPU.IdleLoopTainted)
+		return;
+
+	if ((Address & 0xffc0) == 0x2140 || Address == 0x4212)
+	{
+		if (CPU.IdleLoopReadCount == IDLE_LOOP_MAX_READS)
+		{
+			CPU.IdleLoopTainted = TRUE;
+			return;
+		}
+
+		CPU.IdleLoopReadCycles[CPU.IdleLoopReadCount] = CPU.Cycles - CPU.IdleLoopCycles;
+		CPU.IdleLoopReadAddress[CPU.IdleLoopReadCount] = Address;
+		CPU.IdleLoopReadValue[CPU.IdleLoopReadCount] = (Address == 0x4212) ? REGISTER_4212() : byte;
+		CPU.IdleLoopReadCount++;
+		return;
+	}
+
+	switch (Address)
+	{
+		case 0x2134: // MPYL
+		case 0x2135: // MPYM
+		case 0x2136: // MPYH
+		case 0x4213: // RDIO
+		case 0x4214: // RDDIVL
+		case 0x4215: // RDDIVH
+		case 0x4216: // RDMPYL
+		case 0x4217: // RDMPYH
+		case 0x4218: // JOY1L
+		case 0x4219: // JOY1H
+		case 0x421a: // JOY2L
+		case 0x421b: // JOY2H
+		case 0x421c: // JOY3L
+		case 0x421d: // JOY3H
+		case 0x421e: // JOY4L
+		case 0x421f: // JOY4H
+			return;
+
+		case 0x4210: // RDNMI
+		case 0x4211: // TIMEUP
+			// reading a set flag clears it
+			if (byte & 0x80)
+				CPU.IdleLoopTainted = TRUE;
+			return;
+
+		default:
+			// DMA registers read back as they are, everything else may have side effects
+			if ((Address & 0xff80) != 0x4300)
+				CPU.IdleLoopTainted = TRUE;
+			return;
+	}
+}
+#endif
+
 void S9xDoHEventProcessing (void)
 {
 #ifdef DEBUGGER
@@ -394,6 +553,9 @@ void S9xDoHEventProcessing (void)
 #ifdef CPU_SHUTDOWN
 	CPU.WaitCounter++;
 #endif
+#ifndef SNSFOPT_REMOVED
+	CPU.IdleLoopTainted = TRUE;
+#endif
 
 	switch (CPU.WhichEvent)
 	{
@@ -200,7 +200,9 @@ struct SICPU
 	uint32	FrameAdvanceCount;
 };
 
-extern struct SICPU		ICPU;
+extern THREAD_LOCAL struct SICPU	*S9xICPU;
+
+#define ICPU	(*S9xICPU)
 
 extern struct SOpcodes	S9xOpcodesE1[256];
 extern struct SOpcodes	S9xOpcodesM1X1[256];
@@ -219,6 +221,10 @@ void S9xSoftReset (void);
 void S9xDoHEventProcessing (void);
 void S9xClearIRQ (uint32);
 void S9xSetIRQ (uint32);
+#ifndef SNSFOPT_REMOVED
+void S9xIdleLoopCheck (void);
+void S9xIdleLoopNoteRead (uint32, uint8);
+#endif
 
 static inline void S9xUnpackStatus (void)
 {
@@ -273,6 +273,7 @@ static void Op##OP (void) \
 	newPC.W = REL(JUMP); \
 	if (COND) \
 	{ \
+		bool8	backward = (newPC.W <= Registers.PCw); \
 		AddCycles(ONE_CYCLE); \
 		if (E && Registers.PCh != newPC.B.h) \
 			AddCycles(ONE_CYCLE); \
@@ -281,6 +282,7 @@ static void Op##OP (void) \
 		else \
 			Registers.PCw = newPC.W; \
 		CPUShutdown(); \
+		IdleLoopCheck(backward); \
 	} \
 }
 
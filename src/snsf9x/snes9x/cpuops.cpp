@@ -1598,6 +1598,12 @@ inline void CPUShutdown (void)
 
 #endif
 
+#if !defined(SNSFOPT_REMOVED) && !defined(SA1_OPCODES)
+#define IdleLoopCheck(backward)	if (backward) S9xIdleLoopCheck()
+#else
+#define IdleLoopCheck(backward)	(void) (backward)
+#endif
+
 // BCC
 bOP(90E0,   Relative,     !CheckCarry(),    0, 0)
 bOP(90E1,   Relative,     !CheckCarry(),    0, 1)
@@ -3060,18 +3066,24 @@ static void Op5CSlow (void)
 
 static void Op4C (void)
 {
-	S9xSetPCBase(ICPU.ShiftedPB + ((uint16) Absolute(JUMP)));
+	uint16	addr = Absolute(JUMP);
+	bool8	backward = (addr <= Registers.PCw);
+	S9xSetPCBase(ICPU.ShiftedPB + addr);
 #if defined(CPU_SHUTDOWN) && defined(SA1_OPCODES)
 	CPUShutdown();
 #endif
+	IdleLoopCheck(backward);
 }
 
 static void Op4CSlow (void)
 {
-	S9xSetPCBase(ICPU.ShiftedPB + ((uint16) AbsoluteSlow(JUMP)));
+	uint16	addr = AbsoluteSlow(JUMP);
+	bool8	backward = (addr <= Registers.PCw);
+	S9xSetPCBase(ICPU.ShiftedPB + addr);
 #if defined(CPU_SHUTDOWN) && defined(SA1_OPCODES)
 	CPUShutdown();
 #endif
+	IdleLoopCheck(backward);
 }
 
 static void Op6C (void)
@@ -3598,6 +3610,7 @@ static void OpCB (void)
 	#else
 		AddCycles(TWO_CYCLES);
 #endif
+		IdleLoopCheck(TRUE);
 	}
 #endif	// SA1_OPCODES
 }
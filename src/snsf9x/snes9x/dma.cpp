@@ -189,13 +189,12 @@
 
 #define ADD_CYCLES(n)	CPU.Cycles += (n)
 
-extern uint8	*HDMAMemPointers[8];
 extern int		HDMA_ModeByteCounts[8];
 #ifdef SNSF9X_REMOVED
 extern SPC7110	s7emu;
 #endif
 
-static uint8	sdd1_decode_buffer[0x10000];
+static THREAD_LOCAL uint8	sdd1_decode_buffer[0x10000];
 
 static inline bool8 addCyclesInDMA (uint8);
 static inline bool8 HDMAReadLineCount (int);
@@ -224,6 +223,85 @@ static inline bool8 addCyclesInDMA (uint8 dma_channel)
 	return (TRUE);
 }
 
+#ifndef SNSFOPT_REMOVED
+// B-bus port offset of each byte of a transfer unit, by transfer mode
+static const uint8	DMATransferOffsets[8][4] =
+{
+	{ 0, 0, 0, 0 }, { 0, 1, 0, 1 }, { 0, 0, 0, 0 }, { 0, 0, 1, 1 },
+	{ 0, 1, 2, 3 }, { 0, 1, 0, 1 }, { 0, 0, 0, 0 }, { 0, 0, 1, 1 }
+};
+
+// True if every byte of a transfer unit goes to $2104, $2118, $2119 or $2122,
+// which only change OAM, VRAM and CGRAM
+static bool8 IsGraphicsOnlyTransfer (struct SDMA *d)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		switch ((uint8) (d->BAddress + DMATransferOffsets[d->TransferMode & 7][i]))
+		{
+			case 0x04:
+			case 0x18:
+			case 0x19:
+			case 0x22:
+				break;
+
+			default:
+				return (FALSE);
+		}
+	}
+
+	return (TRUE);
+}
+
+// A write of IsGraphicsOnlyTransfer() with the data left out: the port still
+// steps its address and flip-flop
+static inline void SkipGraphicsWrite (uint8 port)
+{
+	switch (port)
+	{
+		case 0x04: // OAMDATA
+			REGISTER_2104_skip();
+			break;
+
+		case 0x18: // VMDATAL
+		#ifndef CORRECT_VRAM_READS
+			IPPU.FirstVRAMRead = TRUE;
+		#endif
+			REGISTER_2118_skip();
+			break;
+
+		case 0x19: // VMDATAH
+		#ifndef CORRECT_VRAM_READS
+			IPPU.FirstVRAMRead = TRUE;
+		#endif
+			REGISTER_2119_skip();
+			break;
+
+		case 0x22: // CGDATA
+#ifdef SNSF9X_REMOVED
+			REGISTER_2122_skip();
+#endif
+			break;
+	}
+}
+
+// Marks count bytes read by a DMA fast path run from ptr onwards, stepping by inc
+static inline void MarkDMASourceAsRead (uint8 *ptr, int32 inc, int32 count)
+{
+	if (inc > 0)
+		S9xMarkRangeAsRead(ptr, count);
+	else
+	if (inc < 0)
+		S9xMarkRangeAsRead(ptr - (count - 1), count);
+	else
+	{
+		// a fixed source byte saturates after 255 reads
+		for (int32 i = (count < 0xff) ? count : 0xff; i > 0; i--)
+			S9xMarkAsRead(ptr);
+	}
+}
+#endif
+
 bool8 S9xDoDMA (uint8 Channel)
 {
 	CPU.InDMA = TRUE;
@@ -563,6 +641,20 @@ bool8 S9xDoDMA (uint8 Channel)
 		inWRAM_DMA = ((!in_sa1_dma && !in_sdd1_dma && !spc7110_dma) &&
 			(d->ABank == 0x7e || d->ABank == 0x7f || (!(d->ABank & 0x40) && d->AAddress < 0x2000)));
 
+#ifndef SNSFOPT_REMOVED
+		bool8	graphics_only = Settings.AudioOnly && IsGraphicsOnlyTransfer(d);
+
+		// source of the current fast path run, marked as read when the run ends
+		uint8	*mark_start = NULL;
+		int32	mark_count = 0;
+
+		#define MARK_DMA_SOURCE(n) \
+			if (mark_start) \
+				MarkDMASourceAsRead(mark_start, inc, (n));
+#else
+		#define MARK_DMA_SOURCE(n)
+#endif
+
 		// 8 cycles per byte
 		#define	UPDATE_COUNTERS \
 			d->TransferBytes--; \
@@ -570,6 +662,7 @@ bool8 S9xDoDMA (uint8 Channel)
 			p += inc; \
 			if (!addCyclesInDMA(Channel)) \
 			{ \
+				MARK_DMA_SOURCE(mark_count - count + 1); \
 				CPU.InDMA = FALSE; \
 				CPU.InDMAorHDMA = FALSE; \
 				CPU.InWRAMDMAorHDMA = FALSE; \
@@ -735,8 +828,32 @@ bool8 S9xDoDMA (uint8 Channel)
 				}
 			#endif
 			}
+#ifndef SNSFOPT_REMOVED
+			else
+			if (graphics_only)
+			{
+				// audio-only: the data and its coverage do not matter, the port addresses do
+				do
+				{
+					SkipGraphicsWrite((uint8) (d->BAddress + DMATransferOffsets[d->TransferMode & 7][b]));
+					b = (b + 1) & 3;
+					UPDATE_COUNTERS;
+				} while (--count > 0);
+
+				if (d->TransferMode == 1 || d->TransferMode == 5)
+					b &= 1;
+				else
+				if (d->TransferMode == 0 || d->TransferMode == 2 || d->TransferMode == 6)
+					b = 0;
+			}
+#endif
 			else
 			{
+#ifndef SNSFOPT_REMOVED
+				mark_start = base + p;
+				mark_count = count;
+#endif
+
 				// DMA FAST PATH
 				if (d->TransferMode == 0 || d->TransferMode == 2 || d->TransferMode == 6)
 				{
@@ -745,9 +862,6 @@ bool8 S9xDoDMA (uint8 Channel)
 						case 0x04: // OAMDATA
 							do
 							{
-#ifndef SNSFOPT_REMOVED
-								S9xMarkAsRead(base + p);
-#endif
 								Work = *(base + p);
 								REGISTER_2104(Work);
 								UPDATE_COUNTERS;
@@ -763,9 +877,6 @@ bool8 S9xDoDMA (uint8 Channel)
 							{
 								do
 								{
-#ifndef SNSFOPT_REMOVED
-									S9xMarkAsRead(base + p);
-#endif
 									Work = *(base + p);
 									REGISTER_2118_linear(Work);
 									UPDATE_COUNTERS;
@@ -775,9 +886,6 @@ bool8 S9xDoDMA (uint8 Channel)
 							{
 								do
 								{
-#ifndef SNSFOPT_REMOVED
-									S9xMarkAsRead(base + p);
-#endif
 									Work = *(base + p);
 									REGISTER_2118_tile(Work);
 									UPDATE_COUNTERS;
@@ -794,9 +902,6 @@ bool8 S9xDoDMA (uint8 Channel)
 							{
 								do
 								{
-#ifndef SNSFOPT_REMOVED
-									S9xMarkAsRead(base + p);
-#endif
 									Work = *(base + p);
 									REGISTER_2119_linear(Work);
 									UPDATE_COUNTERS;
@@ -806,9 +911,6 @@ bool8 S9xDoDMA (uint8 Channel)
 							{
 								do
 								{
-#ifndef SNSFOPT_REMOVED
-									S9xMarkAsRead(base + p);
-#endif
 									Work = *(base + p);
 									REGISTER_2119_tile(Work);
 									UPDATE_COUNTERS;
@@ -820,9 +922,6 @@ bool8 S9xDoDMA (uint8 Channel)
 						case 0x22: // CGDATA
 							do
 							{
-#ifndef SNSFOPT_REMOVED
-								S9xMarkAsRead(base + p);
-#endif
 								Work = *(base + p);
 #ifdef SNSF9X_REMOVED
 								REGISTER_2122(Work);
@@ -837,9 +936,6 @@ bool8 S9xDoDMA (uint8 Channel)
 							{
 								do
 								{
-#ifndef SNSFOPT_REMOVED
-									S9xMarkAsRead(base + p);
-#endif
 									Work = *(base + p);
 									REGISTER_2180(Work);
 									UPDATE_COUNTERS;
@@ -858,9 +954,6 @@ bool8 S9xDoDMA (uint8 Channel)
 						default:
 							do
 							{
-#ifndef SNSFOPT_REMOVED
-								S9xMarkAsRead(base + p);
-#endif
 								Work = *(base + p);
 								S9xSetPPU(Work, 0x2100 + d->BAddress);
 								UPDATE_COUNTERS;
@@ -885,18 +978,12 @@ bool8 S9xDoDMA (uint8 Channel)
 								default:
 								while (count > 1)
 								{
-#ifndef SNSFOPT_REMOVED
-									S9xMarkAsRead(base + p);
-#endif
 									Work = *(base + p);
 									REGISTER_2118_linear(Work);
 									UPDATE_COUNTERS;
 									count--;
 
 								case 1:
-#ifndef SNSFOPT_REMOVED
-									S9xMarkAsRead(base + p);
-#endif
 									Work = *(base + p);
 									REGISTER_2119_linear(Work);
 									UPDATE_COUNTERS;
@@ -906,9 +993,6 @@ bool8 S9xDoDMA (uint8 Channel)
 
 							if (count == 1)
 							{
-#ifndef SNSFOPT_REMOVED
-								S9xMarkAsRead(base + p);
-#endif
 								Work = *(base + p);
 								REGISTER_2118_linear(Work);
 								UPDATE_COUNTERS;
@@ -924,18 +1008,12 @@ bool8 S9xDoDMA (uint8 Channel)
 								default:
 								while (count > 1)
 								{
-#ifndef SNSFOPT_REMOVED
-									S9xMarkAsRead(base + p);
-#endif
 									Work = *(base + p);
 									REGISTER_2118_tile(Work);
 									UPDATE_COUNTERS;
 									count--;
 
 								case 1:
-#ifndef SNSFOPT_REMOVED
-									S9xMarkAsRead(base + p);
-#endif
 									Work = *(base + p);
 									REGISTER_2119_tile(Work);
 									UPDATE_COUNTERS;
@@ -945,9 +1023,6 @@ bool8 S9xDoDMA (uint8 Channel)
 
 							if (count == 1)
 							{
-#ifndef SNSFOPT_REMOVED
-								S9xMarkAsRead(base + p);
-#endif
 								Work = *(base + p);
 								REGISTER_2118_tile(Work);
 								UPDATE_COUNTERS;
@@ -965,18 +1040,12 @@ bool8 S9xDoDMA (uint8 Channel)
 							default:
 							while (count > 1)
 							{
-#ifndef SNSFOPT_REMOVED
-								S9xMarkAsRead(base + p);
-#endif
 								Work = *(base + p);
 								S9xSetPPU(Work, 0x2100 + d->BAddress);
 								UPDATE_COUNTERS;
 								count--;
 
 							case 1:
-#ifndef SNSFOPT_REMOVED
-								S9xMarkAsRead(base + p);
-#endif
 								Work = *(base + p);
 								S9xSetPPU(Work, 0x2101 + d->BAddress);
 								UPDATE_COUNTERS;
@@ -986,9 +1055,6 @@ bool8 S9xDoDMA (uint8 Channel)
 
 						if (count == 1)
 						{
-#ifndef SNSFOPT_REMOVED
-							S9xMarkAsRead(base + p);
-#endif
 							Work = *(base + p);
 							S9xSetPPU(Work, 0x2100 + d->BAddress);
 							UPDATE_COUNTERS;
@@ -1006,9 +1072,6 @@ bool8 S9xDoDMA (uint8 Channel)
 						default:
 						do
 						{
-#ifndef SNSFOPT_REMOVED
-							S9xMarkAsRead(base + p);
-#endif
 							Work = *(base + p);
 							S9xSetPPU(Work, 0x2100 + d->BAddress);
 							UPDATE_COUNTERS;
@@ -1019,9 +1082,6 @@ bool8 S9xDoDMA (uint8 Channel)
 							}
 
 						case 1:
-#ifndef SNSFOPT_REMOVED
-							S9xMarkAsRead(base + p);
-#endif
 							Work = *(base + p);
 							S9xSetPPU(Work, 0x2100 + d->BAddress);
 							UPDATE_COUNTERS;
@@ -1032,9 +1092,6 @@ bool8 S9xDoDMA (uint8 Channel)
 							}
 
 						case 2:
-#ifndef SNSFOPT_REMOVED
-							S9xMarkAsRead(base + p);
-#endif
 							Work = *(base + p);
 							S9xSetPPU(Work, 0x2101 + d->BAddress);
 							UPDATE_COUNTERS;
@@ -1045,9 +1102,6 @@ bool8 S9xDoDMA (uint8 Channel)
 							}
 
 						case 3:
-#ifndef SNSFOPT_REMOVED
-							S9xMarkAsRead(base + p);
-#endif
 							Work = *(base + p);
 							S9xSetPPU(Work, 0x2101 + d->BAddress);
 							UPDATE_COUNTERS;
@@ -1067,9 +1121,6 @@ bool8 S9xDoDMA (uint8 Channel)
 						default:
 						do
 						{
-#ifndef SNSFOPT_REMOVED
-							S9xMarkAsRead(base + p);
-#endif
 							Work = *(base + p);
 							S9xSetPPU(Work, 0x2100 + d->BAddress);
 							UPDATE_COUNTERS;
@@ -1080,9 +1131,6 @@ bool8 S9xDoDMA (uint8 Channel)
 							}
 
 						case 1:
-#ifndef SNSFOPT_REMOVED
-							S9xMarkAsRead(base + p);
-#endif
 							Work = *(base + p);
 							S9xSetPPU(Work, 0x2101 + d->BAddress);
 							UPDATE_COUNTERS;
@@ -1093,9 +1141,6 @@ bool8 S9xDoDMA (uint8 Channel)
 							}
 
 						case 2:
-#ifndef SNSFOPT_REMOVED
-							S9xMarkAsRead(base + p);
-#endif
 							Work = *(base + p);
 							S9xSetPPU(Work, 0x2102 + d->BAddress);
 							UPDATE_COUNTERS;
@@ -1106,9 +1151,6 @@ bool8 S9xDoDMA (uint8 Channel)
 							}
 
 						case 3:
-#ifndef SNSFOPT_REMOVED
-							S9xMarkAsRead(base + p);
-#endif
 							Work = *(base + p);
 							S9xSetPPU(Work, 0x2103 + d->BAddress);
 							UPDATE_COUNTERS;
@@ -1129,6 +1171,11 @@ bool8 S9xDoDMA (uint8 Channel)
 			#endif
 			}
 
+#ifndef SNSFOPT_REMOVED
+			MARK_DMA_SOURCE(mark_count);
+			mark_start = NULL;
+#endif
+
 			if (rem <= 0)
 				break;
 
@@ -1139,6 +1186,7 @@ bool8 S9xDoDMA (uint8 Channel)
 		}
 
 		#undef UPDATE_COUNTERS
+		#undef MARK_DMA_SOURCE
 	}
     else
     {
@@ -1709,6 +1757,17 @@ uint8 S9xDoHDMA (uint8 byte)
 							}
 						}
 						else
+#ifndef SNSFOPT_REMOVED
+						if (Settings.AudioOnly && IsGraphicsOnlyTransfer(p))
+						{
+							// audio-only: the data and its coverage do not matter, the port addresses do
+							for (int i = 0; i < HDMA_ModeByteCounts[p->TransferMode]; i++)
+								SkipGraphicsWrite((uint8) (p->BAddress + DMATransferOffsets[p->TransferMode][i]));
+							HDMAMemPointers[d] += HDMA_ModeByteCounts[p->TransferMode];
+							ADD_CYCLES(SLOW_ONE_CYCLE * HDMA_ModeByteCounts[p->TransferMode]);
+						}
+						else
+#endif
 						{
 							// HDMA FAST PATH
 							switch (p->TransferMode)
@@ -201,7 +201,11 @@ struct SDMA
 #define TransferBytes	DMACount_Or_HDMAIndirectAddress
 #define IndirectAddress	DMACount_Or_HDMAIndirectAddress
 
-extern struct SDMA	DMA[8];
+extern THREAD_LOCAL struct SDMA	*S9xDMA;
+extern THREAD_LOCAL uint8		**S9xHDMAMemPointers;
+
+#define DMA				S9xDMA
+#define HDMAMemPointers	S9xHDMAMemPointers
 
 bool8 S9xDoDMA (uint8);
 void S9xStartHDMA (void);
@@ -219,7 +219,9 @@
 
 #endif
 
-extern uint8	OpenBus;
+extern THREAD_LOCAL uint8	*S9xOpenBus;
+
+#define OpenBus	(*S9xOpenBus)
 
 static inline int32 memory_speed (uint32 address)
 {
@@ -255,11 +257,14 @@ inline bool S9xMarkAsRead(uint8 * ptrToByte)
 
 			Memory.ROMCoverage[offset]++;
 			Memory.ROMCoverageHistogram[Memory.ROMCoverage[offset]]++;
+			Memory.ROMCoverageUpdates++;
 		}
 		return true;
 	}
 	return false;
 }
+
+void S9xMarkRangeAsRead (uint8 *, uint32);
 #endif
 
 inline uint8 S9xGetByte (uint32 Address)
@@ -290,6 +295,9 @@ inline uint8 S9xGetByte (uint32 Address)
 	{
 		case CMemory::MAP_CPU:
 			byte = S9xGetCPU(Address & 0xffff);
+#ifndef SNSFOPT_REMOVED
+			S9xIdleLoopNoteRead(Address & 0xffff, byte);
+#endif
 			addCyclesInMemoryAccess;
 			return (byte);
 
@@ -298,6 +306,9 @@ inline uint8 S9xGetByte (uint32 Address)
 				return (OpenBus);
 
 			byte = S9xGetPPU(Address & 0xffff);
+#ifndef SNSFOPT_REMOVED
+			S9xIdleLoopNoteRead(Address & 0xffff, byte);
+#endif
 			addCyclesInMemoryAccess;
 			return (byte);
 
@@ -433,8 +444,14 @@ inline uint16 S9xGetWord (uint32 Address, enum s9xwrap_t w = WRAP_NONE)
 	{
 		case CMemory::MAP_CPU:
 			word  = S9xGetCPU(Address & 0xffff);
+#ifndef SNSFOPT_REMOVED
+			S9xIdleLoopNoteRead(Address & 0xffff, (uint8) word);
+#endif
 			addCyclesInMemoryAccess;
 			word |= S9xGetCPU((Address + 1) & 0xffff) << 8;
+#ifndef SNSFOPT_REMOVED
+			S9xIdleLoopNoteRead((Address + 1) & 0xffff, (uint8) (word >> 8));
+#endif
 			addCyclesInMemoryAccess;
 			return (word);
 
@@ -446,8 +463,14 @@ inline uint16 S9xGetWord (uint32 Address, enum s9xwrap_t w = WRAP_NONE)
 			}
 
 			word  = S9xGetPPU(Address & 0xffff);
+#ifndef SNSFOPT_REMOVED
+			S9xIdleLoopNoteRead(Address & 0xffff, (uint8) word);
+#endif
 			addCyclesInMemoryAccess;
 			word |= S9xGetPPU((Address + 1) & 0xffff) << 8;
+#ifndef SNSFOPT_REMOVED
+			S9xIdleLoopNoteRead((Address + 1) & 0xffff, (uint8) (word >> 8));
+#endif
 			addCyclesInMemoryAccess;
 			return (word);
 
@@ -558,6 +581,9 @@ inline void S9xSetByte (uint8 Byte, uint32 Address)
 #ifdef CPU_SHUTDOWN
 	CPU.WaitAddress = 0xffffffff;
 #endif
+#ifndef SNSFOPT_REMOVED
+	CPU.IdleLoopTainted = TRUE;
+#endif
 
 	int		block = (Address & 0xffffff) >> MEMMAP_SHIFT;
 	uint8	*SetAddress = Memory.WriteMap[block];
@@ -722,6 +748,9 @@ inline void S9xSetWord (uint16 Word, uint32 Address, enum s9xwrap_t w = WRAP_NON
 #ifdef CPU_SHUTDOWN
 	CPU.WaitAddress = 0xffffffff;
 #endif
+#ifndef SNSFOPT_REMOVED
+	CPU.IdleLoopTainted = TRUE;
+#endif
 
 	int		block = (Address & 0xffffff) >> MEMMAP_SHIFT;
 	uint8	*SetAddress = Memory.WriteMap[block];
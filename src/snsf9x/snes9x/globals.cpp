@@ -179,6 +179,7 @@
 #include "memmap.h"
 #include "dma.h"
 #include "apu/apu.h"
+#include "context.h"
 #ifdef SNSF9X_REMOVED
 #include "fxinst.h"
 #include "fxemu.h"
@@ -193,13 +194,13 @@
 #endif
 #endif
 
-struct SCPUState		CPU;
-struct SICPU			ICPU;
-struct SRegisters		Registers;
-struct SPPU				PPU;
-struct InternalPPU		IPPU;
-struct SDMA				DMA[8];
-struct STimings			Timings;
+THREAD_LOCAL struct SCPUState		*S9xCPU;
+THREAD_LOCAL struct SICPU			*S9xICPU;
+THREAD_LOCAL struct SRegisters		*S9xRegisters;
+THREAD_LOCAL struct SPPU			*S9xPPU;
+THREAD_LOCAL struct InternalPPU		*S9xIPPU;
+THREAD_LOCAL struct SDMA			*S9xDMA;
+THREAD_LOCAL struct STimings		*S9xTimings;
 #ifdef SNSF9X_REMOVED
 struct SGFX				GFX;
 struct SBG				BG;
@@ -221,9 +222,9 @@ struct SSRTCSnapshot	srtcsnap;
 struct SRTCData			RTCData;
 struct SBSX				BSX;
 #endif
-struct SMulti			Multi;
-struct SSettings		Settings;
-struct SSNESGameFixes	SNESGameFixes;
+THREAD_LOCAL struct SMulti			*S9xMulti;
+THREAD_LOCAL struct SSettings		*S9xSettings;
+THREAD_LOCAL struct SSNESGameFixes	*S9xSNESGameFixes;
 #ifdef NETPLAY_SUPPORT
 struct SNetPlay			NetPlay;
 #endif
@@ -238,11 +239,15 @@ struct FxRegs_s			GSU;
 struct FxInfo_s			SuperFX;
 #endif
 #endif
-CMemory					Memory;
+THREAD_LOCAL CMemory				*S9xMemory;
+
+THREAD_LOCAL char	String[513];
+THREAD_LOCAL uint8	*S9xOpenBus;
+THREAD_LOCAL uint8	**S9xHDMAMemPointers;
+THREAD_LOCAL struct SAPU	*S9xAPU;
+
+static THREAD_LOCAL S9xContext	*S9xCurrentContext = NULL;
 
-char	String[513];
-uint8	OpenBus = 0;
-uint8	*HDMAMemPointers[8];
 uint16	BlackColourMap[256];
 uint16	DirectColourMaps[8][256];
 
@@ -286,6 +291,71 @@ uint32	TWO_LOW_BITS_MASK          = 0;
 uint32	HIGH_BITS_SHIFTED_TWO_MASK = 0;
 #endif
 
+S9xContext * S9xCreateContext (void)
+{
+	S9xContext	*context = new S9xContext;
+
+	memset(context, 0, sizeof(S9xContext));
+	S9xInitAPUContext(&context->apu);
+
+	return (context);
+}
+
+void S9xDestroyContext (S9xContext *context)
+{
+	if (context == S9xCurrentContext)
+		S9xSetContext(NULL);
+
+	delete context;
+}
+
+void S9xSetContext (S9xContext *context)
+{
+	if (context == S9xCurrentContext)
+		return;
+
+	S9xCurrentContext = context;
+
+	if (context == NULL)
+	{
+		S9xCPU = NULL;
+		S9xICPU = NULL;
+		S9xRegisters = NULL;
+		S9xPPU = NULL;
+		S9xIPPU = NULL;
+		S9xDMA = NULL;
+		S9xTimings = NULL;
+		S9xMulti = NULL;
+		S9xSettings = NULL;
+		S9xSNESGameFixes = NULL;
+		S9xMemory = NULL;
+		S9xOpenBus = NULL;
+		S9xHDMAMemPointers = NULL;
+		S9xAPU = NULL;
+		return;
+	}
+
+	S9xCPU = &context->cpu;
+	S9xICPU = &context->icpu;
+	S9xRegisters = &context->registers;
+	S9xPPU = &context->ppu;
+	S9xIPPU = &context->ippu;
+	S9xDMA = context->dma;
+	S9xTimings = &context->timings;
+	S9xMulti = &context->multi;
+	S9xSettings = &context->settings;
+	S9xSNESGameFixes = &context->game_fixes;
+	S9xMemory = &context->memory;
+	S9xOpenBus = &context->open_bus;
+	S9xHDMAMemPointers = context->hdma_mem_pointers;
+	S9xAPU = &context->apu;
+}
+
+S9xContext * S9xGetContext (void)
+{
+	return (S9xCurrentContext);
+}
+
 uint16 SignExtend[2] =
 {
 	0x0000,
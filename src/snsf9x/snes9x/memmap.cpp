@@ -190,6 +190,13 @@
 #include "snes9x.h"
 #include "memmap.h"
 #include "apu/apu.h"
+#ifndef SNSFOPT_REMOVED
+// SSE2 is part of every x86-64 CPU, so it needs no runtime check
+#if defined(__SSE2__) || defined(_M_X64)
+#define MEMMAP_SSE2
+#include <emmintrin.h>
+#endif
+#endif
 #ifdef SNSF9X_REMOVED
 #include "fxemu.h"
 #include "sdd1.h"
@@ -1144,6 +1151,7 @@ bool8 CMemory::Init (void)
 	ZeroMemory(ROMCoverage, MAX_ROM_SIZE);
 #endif
 
+#ifdef SNSF9X_REMOVED
 	IPPU.TileCache[TILE_2BIT]       = (uint8 *) malloc(MAX_2BIT_TILES * 64);
 	IPPU.TileCache[TILE_4BIT]       = (uint8 *) malloc(MAX_4BIT_TILES * 64);
 	IPPU.TileCache[TILE_8BIT]       = (uint8 *) malloc(MAX_8BIT_TILES * 64);
@@ -1159,8 +1167,11 @@ bool8 CMemory::Init (void)
 	IPPU.TileCached[TILE_2BIT_ODD]  = (uint8 *) malloc(MAX_2BIT_TILES);
 	IPPU.TileCached[TILE_4BIT_EVEN] = (uint8 *) malloc(MAX_4BIT_TILES);
 	IPPU.TileCached[TILE_4BIT_ODD]  = (uint8 *) malloc(MAX_4BIT_TILES);
+#endif
 
-	if (!RAM || !SRAM || !VRAM || !ROM ||
+	if (!RAM || !SRAM || !VRAM || !ROM
+#ifdef SNSF9X_REMOVED
+		||
 		!IPPU.TileCache[TILE_2BIT]       ||
 		!IPPU.TileCache[TILE_4BIT]       ||
 		!IPPU.TileCache[TILE_8BIT]       ||
@@ -1174,7 +1185,9 @@ bool8 CMemory::Init (void)
 		!IPPU.TileCached[TILE_2BIT_EVEN] ||
 		!IPPU.TileCached[TILE_2BIT_ODD]  ||
 		!IPPU.TileCached[TILE_4BIT_EVEN] ||
-		!IPPU.TileCached[TILE_4BIT_ODD])
+		!IPPU.TileCached[TILE_4BIT_ODD]
+#endif
+		)
     {
 		Deinit();
 		return (FALSE);
@@ -1185,6 +1198,7 @@ bool8 CMemory::Init (void)
 	ZeroMemory(VRAM, 0x10000);
 	ZeroMemory(ROM,  MAX_ROM_SIZE + 0x200 + 0x8000);
 
+#ifdef SNSF9X_REMOVED
 	ZeroMemory(IPPU.TileCache[TILE_2BIT],       MAX_2BIT_TILES * 64);
 	ZeroMemory(IPPU.TileCache[TILE_4BIT],       MAX_4BIT_TILES * 64);
 	ZeroMemory(IPPU.TileCache[TILE_8BIT],       MAX_8BIT_TILES * 64);
@@ -1200,6 +1214,7 @@ bool8 CMemory::Init (void)
 	ZeroMemory(IPPU.TileCached[TILE_2BIT_ODD],  MAX_2BIT_TILES);
 	ZeroMemory(IPPU.TileCached[TILE_4BIT_EVEN], MAX_4BIT_TILES);
 	ZeroMemory(IPPU.TileCached[TILE_4BIT_ODD],  MAX_4BIT_TILES);
+#endif
 
 	// FillRAM uses first 32K of ROM image area, otherwise space just
 	// wasted. Might be read by the SuperFX code.
@@ -1286,6 +1301,7 @@ void CMemory::Deinit (void)
 	}
 #endif
 
+#ifdef SNSF9X_REMOVED
 	for (int t = 0; t < 7; t++)
 	{
 		if (IPPU.TileCache[t])
@@ -1300,11 +1316,42 @@ void CMemory::Deinit (void)
 			IPPU.TileCached[t] = NULL;
 		}
 	}
+#endif
 
 	Safe(NULL);
 	SafeANK(NULL);
 }
 
+#ifndef SNSFOPT_REMOVED
+// Same as S9xMarkAsRead() on each byte of a contiguous span, but bytes
+// whose coverage count has already saturated are skipped in bulk
+void S9xMarkRangeAsRead (uint8 *ptrToStart, uint32 size)
+{
+	if (ptrToStart < Memory.ROM || ptrToStart >= Memory.ROM + CMemory::MAX_ROM_SIZE)
+		return;
+
+	uint32	offset = ptrToStart - Memory.ROM;
+	uint32	end = offset + min(size, CMemory::MAX_ROM_SIZE - offset);
+	uint8	*coverage = Memory.ROMCoverage;
+
+	while (offset < end)
+	{
+	#ifdef MEMMAP_SSE2
+		const __m128i	saturated = _mm_set1_epi8((char) 0xff);
+		while (end - offset >= 16 &&
+			_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) &coverage[offset]), saturated)) == 0xffff)
+			offset += 16;
+	#endif
+
+		for (uint32 chunk_end = min(offset + 16, end); offset < chunk_end; offset++)
+		{
+			if (coverage[offset] < 0xff)
+				S9xMarkAsRead(&Memory.ROM[offset]);
+		}
+	}
+}
+#endif
+
 // file management and ROM detection
 
 static bool8 allASCII (uint8 *b, int size)
@@ -2311,8 +2358,8 @@ static uint32 caCRC32 (uint8 *array, uint32 size, uint32 crc32)
 
 char * CMemory::Safe (const char *s)
 {
-	static char	*safe = NULL;
-	static int	safe_len = 0;
+	static THREAD_LOCAL char	*safe = NULL;
+	static THREAD_LOCAL int	safe_len = 0;
 
 	if (s == NULL)
 	{
@@ -2350,8 +2397,8 @@ char * CMemory::Safe (const char *s)
 
 char * CMemory::SafeANK (const char *s)
 {
-	static char	*safe = NULL;
-	static int	safe_len = 0;
+	static THREAD_LOCAL char	*safe = NULL;
+	static THREAD_LOCAL int	safe_len = 0;
 
 	if (s == NULL)
 	{
@@ -3562,7 +3609,7 @@ const char * CMemory::MapType (void)
 
 const char * CMemory::StaticRAMSize (void)
 {
-	static char	str[20];
+	static THREAD_LOCAL char	str[20];
 
 	if (SRAMSize > 16)
 		strcpy(str, "Corrupt");
@@ -3574,7 +3621,7 @@ const char * CMemory::StaticRAMSize (void)
 
 const char * CMemory::Size (void)
 {
-	static char	str[20];
+	static THREAD_LOCAL char	str[20];
 
 	if (Multi.cartType == 4)
 		strcpy(str, "N/A");
@@ -3589,7 +3636,7 @@ const char * CMemory::Size (void)
 
 const char * CMemory::Revision (void)
 {
-	static char	str[20];
+	static THREAD_LOCAL char	str[20];
 
 	sprintf(str, "1.%d", HiROM ? ((ExtendedFormat != NOPE) ? ROM[0x40ffdb] : ROM[0xffdb]) : ROM[0x7fdb]);
 
@@ -3598,7 +3645,7 @@ const char * CMemory::Revision (void)
 
 const char * CMemory::KartContents (void)
 {
-	static char			str[64];
+	static THREAD_LOCAL char			str[64];
 	static const char	*contents[3] = { "ROM", "ROM+RAM", "ROM+RAM+BAT" };
 
 	char	chip[16];
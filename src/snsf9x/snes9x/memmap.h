@@ -242,6 +242,7 @@ struct CMemory
 	uint8	*ROMCoverage;
 	uint32	ROMCoverageSize;
 	uint32	ROMCoverageHistogram[256];
+	uint32	ROMCoverageUpdates;
 #endif
 
 	uint8	*Map[MEMMAP_NUM_BLOCKS];
@@ -367,8 +368,11 @@ struct SMulti
 	char	fileNameA[PATH_MAX + 1], fileNameB[PATH_MAX + 1];
 };
 
-extern CMemory	Memory;
-extern SMulti	Multi;
+extern THREAD_LOCAL CMemory	*S9xMemory;
+extern THREAD_LOCAL SMulti	*S9xMulti;
+
+#define Memory	(*S9xMemory)
+#define Multi	(*S9xMulti)
 
 #if defined(ZSNES_FX) || defined(ZSNES_C4)
 START_EXTERN_C
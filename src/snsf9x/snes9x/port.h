@@ -217,6 +217,17 @@
 #define alwaysinline  inline
 #endif
 
+// Storage class for the per-thread pointers to the bound emulator context.
+// C++11 thread_local is avoided on purpose: extern thread_local variables are
+// accessed through an init wrapper call, which is too slow for the core loops.
+#if defined(__GNUC__)
+#define THREAD_LOCAL  __thread
+#elif defined(_MSC_VER)
+#define THREAD_LOCAL  __declspec(thread)
+#else
+#define THREAD_LOCAL  thread_local
+#endif
+
 #ifndef snes9x_types_defined
 #define snes9x_types_defined
 typedef unsigned char		bool8;
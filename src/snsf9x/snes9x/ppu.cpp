@@ -202,8 +202,6 @@
 #endif
 #endif
 
-extern uint8	*HDMAMemPointers[8];
-
 
 static inline void S9xLatchCounters (bool force)
 {
@@ -2227,6 +2225,7 @@ void S9xSoftResetPPU (void)
 	IPPU.ColorsChanged = TRUE;
 	IPPU.OBJChanged = TRUE;
 	IPPU.DirectColourMapsNeedRebuild = TRUE;
+#ifdef SNSF9X_REMOVED
 	ZeroMemory(IPPU.TileCached[TILE_2BIT], MAX_2BIT_TILES);
 	ZeroMemory(IPPU.TileCached[TILE_4BIT], MAX_4BIT_TILES);
 	ZeroMemory(IPPU.TileCached[TILE_8BIT], MAX_8BIT_TILES);
@@ -2234,6 +2233,7 @@ void S9xSoftResetPPU (void)
 	ZeroMemory(IPPU.TileCached[TILE_2BIT_ODD],  MAX_2BIT_TILES);
 	ZeroMemory(IPPU.TileCached[TILE_4BIT_EVEN], MAX_4BIT_TILES);
 	ZeroMemory(IPPU.TileCached[TILE_4BIT_ODD],  MAX_4BIT_TILES);
+#endif
 #ifdef CORRECT_VRAM_READS
 	IPPU.VRAMReadBuffer = 0; // XXX: FIXME: anything better?
 #else
@@ -216,8 +216,10 @@ struct InternalPPU
 	bool8	ColorsChanged;
 	bool8	OBJChanged;
 	bool8	DirectColourMapsNeedRebuild;
+#ifdef SNSF9X_REMOVED
 	uint8	*TileCache[7];
 	uint8	*TileCached[7];
+#endif
 #ifdef CORRECT_VRAM_READS
 	uint16	VRAMReadBuffer;
 #else
@@ -375,8 +377,11 @@ struct SPPU
 };
 
 extern uint16				SignExtend[2];
-extern struct SPPU			PPU;
-extern struct InternalPPU	IPPU;
+extern THREAD_LOCAL struct SPPU			*S9xPPU;
+extern THREAD_LOCAL struct InternalPPU	*S9xIPPU;
+
+#define PPU		(*S9xPPU)
+#define IPPU	(*S9xIPPU)
 
 void S9xResetPPU (void);
 void S9xSoftResetPPU (void);
@@ -542,6 +547,7 @@ static inline void REGISTER_2118 (uint8 Byte)
 	else
 		Memory.VRAM[address = (PPU.VMA.Address << 1) & 0xffff] = Byte;
 
+#ifdef SNSF9X_REMOVED
 	IPPU.TileCached[TILE_2BIT][address >> 4] = FALSE;
 	IPPU.TileCached[TILE_4BIT][address >> 5] = FALSE;
 	IPPU.TileCached[TILE_8BIT][address >> 6] = FALSE;
@@ -553,6 +559,7 @@ static inline void REGISTER_2118 (uint8 Byte)
 	IPPU.TileCached[TILE_4BIT_EVEN][((address >> 5) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
 	IPPU.TileCached[TILE_4BIT_ODD] [address >> 5] = FALSE;
 	IPPU.TileCached[TILE_4BIT_ODD] [((address >> 5) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
+#endif
 
 	if (!PPU.VMA.High)
 	{
@@ -579,6 +586,7 @@ static inline void REGISTER_2119 (uint8 Byte)
 	else
 		Memory.VRAM[address = ((PPU.VMA.Address << 1) + 1) & 0xffff] = Byte;
 
+#ifdef SNSF9X_REMOVED
 	IPPU.TileCached[TILE_2BIT][address >> 4] = FALSE;
 	IPPU.TileCached[TILE_4BIT][address >> 5] = FALSE;
 	IPPU.TileCached[TILE_8BIT][address >> 6] = FALSE;
@@ -590,6 +598,7 @@ static inline void REGISTER_2119 (uint8 Byte)
 	IPPU.TileCached[TILE_4BIT_EVEN][((address >> 5) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
 	IPPU.TileCached[TILE_4BIT_ODD] [address >> 5] = FALSE;
 	IPPU.TileCached[TILE_4BIT_ODD] [((address >> 5) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
+#endif
 
 	if (PPU.VMA.High)
 	{
@@ -610,6 +619,7 @@ static inline void REGISTER_2118_tile (uint8 Byte)
 
 	Memory.VRAM[address] = Byte;
 
+#ifdef SNSF9X_REMOVED
 	IPPU.TileCached[TILE_2BIT][address >> 4] = FALSE;
 	IPPU.TileCached[TILE_4BIT][address >> 5] = FALSE;
 	IPPU.TileCached[TILE_8BIT][address >> 6] = FALSE;
@@ -621,6 +631,7 @@ static inline void REGISTER_2118_tile (uint8 Byte)
 	IPPU.TileCached[TILE_4BIT_EVEN][((address >> 5) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
 	IPPU.TileCached[TILE_4BIT_ODD] [address >> 5] = FALSE;
 	IPPU.TileCached[TILE_4BIT_ODD] [((address >> 5) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
+#endif
 
 	if (!PPU.VMA.High)
 		PPU.VMA.Address += PPU.VMA.Increment;
@@ -635,6 +646,7 @@ static inline void REGISTER_2119_tile (uint8 Byte)
 
 	Memory.VRAM[address] = Byte;
 
+#ifdef SNSF9X_REMOVED
 	IPPU.TileCached[TILE_2BIT][address >> 4] = FALSE;
 	IPPU.TileCached[TILE_4BIT][address >> 5] = FALSE;
 	IPPU.TileCached[TILE_8BIT][address >> 6] = FALSE;
@@ -646,6 +658,7 @@ static inline void REGISTER_2119_tile (uint8 Byte)
 	IPPU.TileCached[TILE_4BIT_EVEN][((address >> 5) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
 	IPPU.TileCached[TILE_4BIT_ODD] [address >> 5] = FALSE;
 	IPPU.TileCached[TILE_4BIT_ODD] [((address >> 5) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
+#endif
 
 	if (PPU.VMA.High)
 		PPU.VMA.Address += PPU.VMA.Increment;
@@ -659,6 +672,7 @@ static inline void REGISTER_2118_linear (uint8 Byte)
 
 	Memory.VRAM[address = (PPU.VMA.Address << 1) & 0xffff] = Byte;
 
+#ifdef SNSF9X_REMOVED
 	IPPU.TileCached[TILE_2BIT][address >> 4] = FALSE;
 	IPPU.TileCached[TILE_4BIT][address >> 5] = FALSE;
 	IPPU.TileCached[TILE_8BIT][address >> 6] = FALSE;
@@ -670,6 +684,7 @@ static inline void REGISTER_2118_linear (uint8 Byte)
 	IPPU.TileCached[TILE_4BIT_EVEN][((address >> 5) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
 	IPPU.TileCached[TILE_4BIT_ODD] [address >> 5] = FALSE;
 	IPPU.TileCached[TILE_4BIT_ODD] [((address >> 5) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
+#endif
 
 	if (!PPU.VMA.High)
 		PPU.VMA.Address += PPU.VMA.Increment;
@@ -683,6 +698,7 @@ static inline void REGISTER_2119_linear (uint8 Byte)
 
 	Memory.VRAM[address = ((PPU.VMA.Address << 1) + 1) & 0xffff] = Byte;
 
+#ifdef SNSF9X_REMOVED
 	IPPU.TileCached[TILE_2BIT][address >> 4] = FALSE;
 	IPPU.TileCached[TILE_4BIT][address >> 5] = FALSE;
 	IPPU.TileCached[TILE_8BIT][address >> 6] = FALSE;
@@ -694,6 +710,7 @@ static inline void REGISTER_2119_linear (uint8 Byte)
 	IPPU.TileCached[TILE_4BIT_EVEN][((address >> 5) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
 	IPPU.TileCached[TILE_4BIT_ODD] [address >> 5] = FALSE;
 	IPPU.TileCached[TILE_4BIT_ODD] [((address >> 5) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
+#endif
 
 	if (PPU.VMA.High)
 		PPU.VMA.Address += PPU.VMA.Increment;
@@ -735,6 +752,76 @@ static inline void REGISTER_2122 (uint8 Byte)
 }
 #endif
 
+#ifndef SNSFOPT_REMOVED
+// Audio-only DMA skips the data of graphics ports, but the address and
+// flip-flop a write leaves behind must still move on
+static inline void REGISTER_2104_skip (void)
+{
+	if (PPU.OAMAddr & 0x100)
+	{
+		PPU.OAMFlip ^= 1;
+		if (!(PPU.OAMFlip & 1))
+		{
+			++PPU.OAMAddr;
+			PPU.OAMAddr &= 0x1ff;
+			if (PPU.OAMPriorityRotation && PPU.FirstSprite != (PPU.OAMAddr >> 1))
+			{
+				PPU.FirstSprite = (PPU.OAMAddr & 0xfe) >> 1;
+				IPPU.OBJChanged = TRUE;
+			}
+		}
+		else
+		{
+			if (PPU.OAMPriorityRotation && (PPU.OAMAddr & 1))
+				IPPU.OBJChanged = TRUE;
+		}
+	}
+	else
+	if (!(PPU.OAMFlip & 1))
+	{
+		PPU.OAMFlip |= 1;
+		if (PPU.OAMPriorityRotation && (PPU.OAMAddr & 1))
+			IPPU.OBJChanged = TRUE;
+	}
+	else
+	{
+		PPU.OAMFlip &= ~1;
+		++PPU.OAMAddr;
+		if (PPU.OAMPriorityRotation && PPU.FirstSprite != (PPU.OAMAddr >> 1))
+		{
+			PPU.FirstSprite = (PPU.OAMAddr & 0xfe) >> 1;
+			IPPU.OBJChanged = TRUE;
+		}
+	}
+}
+
+static inline void REGISTER_2118_skip (void)
+{
+	CHECK_INBLANK();
+
+	if (!PPU.VMA.High)
+		PPU.VMA.Address += PPU.VMA.Increment;
+}
+
+static inline void REGISTER_2119_skip (void)
+{
+	CHECK_INBLANK();
+
+	if (PPU.VMA.High)
+		PPU.VMA.Address += PPU.VMA.Increment;
+}
+
+#ifdef SNSF9X_REMOVED
+static inline void REGISTER_2122_skip (void)
+{
+	if (PPU.CGFLIP)
+		PPU.CGADD++;
+
+	PPU.CGFLIP ^= 1;
+}
+#endif
+#endif
+
 static inline void REGISTER_2180 (uint8 Byte)
 {
 	Memory.RAM[PPU.WRAM++] = Byte;
@@ -0,0 +1,433 @@
+/***********************************************************************************
+  Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+
+  (c) Copyright 1996 - 2002  Gary Henderson (gary.henderson@ntlworld.com),
+                             Jerremy Koot (jkoot@snes9x.com)
+
+  (c) Copyright 2002 - 2004  Matthew Kendora
+
+  (c) Copyright 2002 - 2005  Peter Bortas (peter@bortas.org)
+
+  (c) Copyright 2004 - 2005  Joel Yliluoma (http://iki.fi/bisqwit/)
+
+  (c) Copyright 2001 - 2006  John Weidman (jweidman@slip.net)
+
+  (c) Copyright 2002 - 2006  funkyass (funkyass@spam.shaw.ca),
+                             Kris Bleakley (codeviolation@hotmail.com)
+
+  (c) Copyright 2002 - 2010  Brad Jorsch (anomie@users.sourceforge.net),
+                             Nach (n-a-c-h@users.sourceforge.net),
+                             zones (kasumitokoduck@yahoo.com)
+
+  (c) Copyright 2006 - 2007  nitsuja
+
+  (c) Copyright 2009 - 2010  BearOso,
+                             OV2
+
+
+  BS-X C emulator code
+  (c) Copyright 2005 - 2006  Dreamer Nom,
+                             zones
+
+  C4 x86 assembler and some C emulation code
+  (c) Copyright 2000 - 2003  _Demo_ (_demo_@zsnes.com),
+                             Nach,
+                             zsKnight (zsknight@zsnes.com)
+
+  C4 C++ code
+  (c) Copyright 2003 - 2006  Brad Jorsch,
+                             Nach
+
+  DSP-1 emulator code
+  (c) Copyright 1998 - 2006  _Demo_,
+                             Andreas Naive (andreasnaive@gmail.com),
+                             Gary Henderson,
+                             Ivar (ivar@snes9x.com),
+                             John Weidman,
+                             Kris Bleakley,
+                             Matthew Kendora,
+                             Nach,
+                             neviksti (neviksti@hotmail.com)
+
+  DSP-2 emulator code
+  (c) Copyright 2003         John Weidman,
+                             Kris Bleakley,
+                             Lord Nightmare (lord_nightmare@users.sourceforge.net),
+                             Matthew Kendora,
+                             neviksti
+
+  DSP-3 emulator code
+  (c) Copyright 2003 - 2006  John Weidman,
+                             Kris Bleakley,
+                             Lancer,
+                             z80 gaiden
+
+  DSP-4 emulator code
+  (c) Copyright 2004 - 2006  Dreamer Nom,
+                             John Weidman,
+                             Kris Bleakley,
+                             Nach,
+                             z80 gaiden
+
+  OBC1 emulator code
+  (c) Copyright 2001 - 2004  zsKnight,
+                             pagefault (pagefault@zsnes.com),
+                             Kris Bleakley
+                             Ported from x86 assembler to C by sanmaiwashi
+
+  SPC7110 and RTC C++ emulator code used in 1.39-1.51
+  (c) Copyright 2002         Matthew Kendora with research by
+                             zsKnight,
+                             John Weidman,
+                             Dark Force
+
+  SPC7110 and RTC C++ emulator code used in 1.52+
+  (c) Copyright 2009         byuu,
+                             neviksti
+
+  S-DD1 C emulator code
+  (c) Copyright 2003         Brad Jorsch with research by
+                             Andreas Naive,
+                             John Weidman
+
+  S-RTC C emulator code
+  (c) Copyright 2001 - 2006  byuu,
+                             John Weidman
+
+  ST010 C++ emulator code
+  (c) Copyright 2003         Feather,
+                             John Weidman,
+                             Kris Bleakley,
+                             Matthew Kendora
+
+  Super FX x86 assembler emulator code
+  (c) Copyright 1998 - 2003  _Demo_,
+                             pagefault,
+                             zsKnight
+
+  Super FX C emulator code
+  (c) Copyright 1997 - 1999  Ivar,
+                             Gary Henderson,
+                             John Weidman
+
+  Sound emulator code used in 1.5-1.51
+  (c) Copyright 1998 - 2003  Brad Martin
+  (c) Copyright 1998 - 2006  Charles Bilyue'
+
+  Sound emulator code used in 1.52+
+  (c) Copyright 2004 - 2007  Shay Green (gblargg@gmail.com)
+
+  SH assembler code partly based on x86 assembler code
+  (c) Copyright 2002 - 2004  Marcus Comstedt (marcus@mc.pp.se)
+
+  2xSaI filter
+  (c) Copyright 1999 - 2001  Derek Liauw Kie Fa
+
+  HQ2x, HQ3x, HQ4x filters
+  (c) Copyright 2003         Maxim Stepin (maxim@hiend3d.com)
+
+  NTSC filter
+  (c) Copyright 2006 - 2007  Shay Green
+
+  GTK+ GUI code
+  (c) Copyright 2004 - 2010  BearOso
+
+  Win32 GUI code
+  (c) Copyright 2003 - 2006  blip,
+                             funkyass,
+                             Matthew Kendora,
+                             Nach,
+                             nitsuja
+  (c) Copyright 2009 - 2010  OV2
+
+  Mac OS GUI code
+  (c) Copyright 1998 - 2001  John Stiles
+  (c) Copyright 2001 - 2010  zones
+
+
+  Specific ports contains the works of other authors. See headers in
+  individual files.
+
+
+  Snes9x homepage: http://www.snes9x.com/
+
+  Permission to use, copy, modify and/or distribute Snes9x in both binary
+  and source form, for non-commercial purposes, is hereby granted without
+  fee, providing that this license information and copyright notice appear
+  with all copies and any derived work.
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event shall the authors be held liable for any damages
+  arising from the use of this software or it's derivatives.
+
+  Snes9x is freeware for PERSONAL USE only. Commercial users should
+  seek permission of the copyright holders first. Commercial use includes,
+  but is not limited to, charging money for Snes9x or software derived from
+  Snes9x, including Snes9x or derivatives in commercial game bundles, and/or
+  using Snes9x as a promotion for your commercial product.
+
+  The copyright holders request that bug fixes and improvements to the code
+  should be forwarded to them so everyone can benefit from the modifications
+  in future versions.
+
+  Super NES and Super Nintendo Entertainment System are trademarks of
+  Nintendo Co., Limited and its subsidiary companies.
+ ***********************************************************************************/
+
+
+#include "snes9x.h"
+#include "memmap.h"
+#include "dma.h"
+#include "apu/apu.h"
+#include "cpuexec.h"
+#include "getset.h"
+#include "sdd1.h"
+#include "snapshot.h"
+
+// In-memory save states. A state holds everything the emulated SNES changes
+// at run time, including the coverage collected so far. The ROM image and the
+// memory map are not part of it: a state can only be restored into a context
+// that has the same game loaded, by the same build. The ROM may have been
+// patched in between.
+
+// Bump SNAPSHOT_VERSION whenever the layout of the state changes, and
+// APU_FREEZE_VERSION in apu.cpp for the APU part. The on-disk caches of
+// snsfopt are keyed by both.
+#define SNAPSHOT_MAGIC		"S9XMEMST"
+#define SNAPSHOT_VERSION	3
+
+struct SSnapshotHeader
+{
+	char	Magic[8];
+	uint32	Version;
+	uint32	Size;
+	uint32	ROMSize;
+};
+
+// pointers into emulated memory are saved as a region and an offset
+enum
+{
+	SNAPSHOT_REGION_NONE,
+	SNAPSHOT_REGION_RAM,
+	SNAPSHOT_REGION_SRAM,
+	SNAPSHOT_REGION_VRAM,
+	SNAPSHOT_REGION_ROM,	// FillRAM and the ROM image behind it
+	SNAPSHOT_REGION_COUNT
+};
+
+struct SSnapshotPointer
+{
+	uint32	Region;
+	uint32	Offset;
+};
+
+static uint8 * GetRegion (uint32 region, uint32 *size)
+{
+	switch (region)
+	{
+		case SNAPSHOT_REGION_RAM:
+			*size = 0x20000;
+			return (Memory.RAM);
+
+		case SNAPSHOT_REGION_SRAM:
+			*size = 0x20000;
+			return (Memory.SRAM);
+
+		case SNAPSHOT_REGION_VRAM:
+			*size = 0x10000;
+			return (Memory.VRAM);
+
+		case SNAPSHOT_REGION_ROM:
+			*size = 0x8000 + CMemory::MAX_ROM_SIZE + 0x200;
+			return (Memory.FillRAM);
+
+		default:
+			*size = 0;
+			return (NULL);
+	}
+}
+
+static SSnapshotPointer FreezePointer (const uint8 *ptr)
+{
+	SSnapshotPointer	p = { SNAPSHOT_REGION_NONE, 0 };
+
+	for (uint32 region = SNAPSHOT_REGION_NONE + 1; ptr && region < SNAPSHOT_REGION_COUNT; region++)
+	{
+		uint32	size;
+		uint8	*base = GetRegion(region, &size);
+
+		if (base && ptr >= base && ptr <= base + size)
+		{
+			p.Region = region;
+			p.Offset = ptr - base;
+			break;
+		}
+	}
+
+	return (p);
+}
+
+static uint8 * UnfreezePointer (const SSnapshotPointer &p)
+{
+	uint32	size;
+	uint8	*base = GetRegion(p.Region, &size);
+
+	if (!base || p.Offset > size)
+		return (NULL);
+
+	return (base + p.Offset);
+}
+
+static void FreezeBlock (uint8 **buf, const void *data, uint32 size)
+{
+	memcpy(*buf, data, size);
+	*buf += size;
+}
+
+static void UnfreezeBlock (const uint8 **buf, void *data, uint32 size)
+{
+	memcpy(data, *buf, size);
+	*buf += size;
+}
+
+// Layout version of the state, without the APU part (see S9xAPUFreezeVersion())
+uint32 S9xFreezeVersion (void)
+{
+	return (SNAPSHOT_VERSION);
+}
+
+uint32 S9xFreezeSize (void)
+{
+	return (sizeof(SSnapshotHeader) +
+		sizeof(CPU) + sizeof(Registers) + sizeof(ICPU) + sizeof(PPU) + sizeof(IPPU) +
+		sizeof(DMA[0]) * 8 + sizeof(Timings) + sizeof(OpenBus) +
+		sizeof(SSnapshotPointer) * (8 + 1) +
+		0x20000 + 0x20000 + 0x10000 + 0x8000 +
+		sizeof(Memory.ROMCoverageSize) + sizeof(Memory.ROMCoverageHistogram) + Memory.CalculatedSize +
+		S9xAPUFreezeSize());
+}
+
+bool8 S9xFreezeGameMem (uint8 *buf, uint32 bufSize)
+{
+	if (bufSize < S9xFreezeSize())
+		return (FALSE);
+
+	uint8			*ptr = buf;
+	SSnapshotHeader	header;
+	SSnapshotPointer	p;
+
+	memcpy(header.Magic, SNAPSHOT_MAGIC, sizeof(header.Magic));
+	header.Version = SNAPSHOT_VERSION;
+	header.Size = S9xFreezeSize();
+	header.ROMSize = Memory.CalculatedSize;
+	FreezeBlock(&ptr, &header, sizeof(header));
+
+	FreezeBlock(&ptr, &CPU, sizeof(CPU));
+	FreezeBlock(&ptr, &Registers, sizeof(Registers));
+	FreezeBlock(&ptr, &ICPU, sizeof(ICPU));
+	FreezeBlock(&ptr, &PPU, sizeof(PPU));
+	FreezeBlock(&ptr, &IPPU, sizeof(IPPU));
+	FreezeBlock(&ptr, DMA, sizeof(DMA[0]) * 8);
+	FreezeBlock(&ptr, &Timings, sizeof(Timings));
+	FreezeBlock(&ptr, &OpenBus, sizeof(OpenBus));
+
+	for (int d = 0; d < 8; d++)
+	{
+		p = FreezePointer(HDMAMemPointers[d]);
+		FreezeBlock(&ptr, &p, sizeof(p));
+	}
+
+	p = FreezePointer(Memory.BWRAM);
+	FreezeBlock(&ptr, &p, sizeof(p));
+
+	FreezeBlock(&ptr, Memory.RAM, 0x20000);
+	FreezeBlock(&ptr, Memory.SRAM, 0x20000);
+	FreezeBlock(&ptr, Memory.VRAM, 0x10000);
+	FreezeBlock(&ptr, Memory.FillRAM, 0x8000);
+
+	FreezeBlock(&ptr, &Memory.ROMCoverageSize, sizeof(Memory.ROMCoverageSize));
+	FreezeBlock(&ptr, Memory.ROMCoverageHistogram, sizeof(Memory.ROMCoverageHistogram));
+	FreezeBlock(&ptr, Memory.ROMCoverage, Memory.CalculatedSize);
+
+	S9xAPUFreeze(ptr);
+
+	return (TRUE);
+}
+
+bool8 S9xUnfreezeGameMem (const uint8 *buf, uint32 bufSize)
+{
+	const uint8		*ptr = buf;
+	SSnapshotHeader	header;
+	SSnapshotPointer	p;
+
+	if (bufSize < sizeof(header))
+		return (FALSE);
+
+	UnfreezeBlock(&ptr, &header, sizeof(header));
+	if (memcmp(header.Magic, SNAPSHOT_MAGIC, sizeof(header.Magic)) != 0 ||
+		header.Version != SNAPSHOT_VERSION ||
+		header.ROMSize != Memory.CalculatedSize ||
+		header.Size != S9xFreezeSize() || header.Size > bufSize)
+		return (FALSE);
+
+	// these point to buffers of this context, not to emulated state
+	uint8	*XB = IPPU.XB;
+#ifdef SNSF9X_REMOVED
+	uint8	*TileCache[7], *TileCached[7];
+	memcpy(TileCache, IPPU.TileCache, sizeof(TileCache));
+	memcpy(TileCached, IPPU.TileCached, sizeof(TileCached));
+#endif
+
+	UnfreezeBlock(&ptr, &CPU, sizeof(CPU));
+	UnfreezeBlock(&ptr, &Registers, sizeof(Registers));
+	UnfreezeBlock(&ptr, &ICPU, sizeof(ICPU));
+	UnfreezeBlock(&ptr, &PPU, sizeof(PPU));
+	UnfreezeBlock(&ptr, &IPPU, sizeof(IPPU));
+	UnfreezeBlock(&ptr, DMA, sizeof(DMA[0]) * 8);
+	UnfreezeBlock(&ptr, &Timings, sizeof(Timings));
+	UnfreezeBlock(&ptr, &OpenBus, sizeof(OpenBus));
+
+#ifdef SNSF9X_REMOVED
+	memcpy(IPPU.TileCache, TileCache, sizeof(TileCache));
+	memcpy(IPPU.TileCached, TileCached, sizeof(TileCached));
+#endif
+	IPPU.XB = XB;
+
+	// a pointer that cannot be restored is looked up again by the next HDMA
+	for (int d = 0; d < 8; d++)
+	{
+		UnfreezeBlock(&ptr, &p, sizeof(p));
+		HDMAMemPointers[d] = UnfreezePointer(p);
+	}
+
+	UnfreezeBlock(&ptr, &p, sizeof(p));
+	Memory.BWRAM = UnfreezePointer(p);
+
+	UnfreezeBlock(&ptr, Memory.RAM, 0x20000);
+	UnfreezeBlock(&ptr, Memory.SRAM, 0x20000);
+	UnfreezeBlock(&ptr, Memory.VRAM, 0x10000);
+	UnfreezeBlock(&ptr, Memory.FillRAM, 0x8000);
+
+	UnfreezeBlock(&ptr, &Memory.ROMCoverageSize, sizeof(Memory.ROMCoverageSize));
+	UnfreezeBlock(&ptr, Memory.ROMCoverageHistogram, sizeof(Memory.ROMCoverageHistogram));
+	UnfreezeBlock(&ptr, Memory.ROMCoverage, Memory.CalculatedSize);
+
+	S9xAPUUnfreeze((uint8 *) ptr);
+
+	// rebuild what derives from the restored state, keeping the memory speed
+	// of the last opcode fetch
+	int32	MemSpeed = CPU.MemSpeed, MemSpeedx2 = CPU.MemSpeedx2;
+	S9xSetPCBase(Registers.PBPC);
+	CPU.MemSpeed = MemSpeed;
+	CPU.MemSpeedx2 = MemSpeedx2;
+	S9xFixCycles();
+
+	// the idle loop being measured refers to the coverage of the saving instance
+	CPU.IdleLoopPBPC = 0xffffffff;
+	CPU.IdleLoopTainted = TRUE;
+
+	if (Settings.SDD1)
+		S9xSDD1PostLoadState();
+
+	return (TRUE);
+}
@@ -270,6 +270,9 @@
 #define FRAME_ADVANCE_FLAG	(1 <<  9)
 
 #define ROM_NAME_LEN	23
+#ifndef SNSFOPT_REMOVED
+#define IDLE_LOOP_MAX_READS	8
+#endif
 #define AUTO_FRAMERATE	200
 
 struct SCPUState
@@ -298,6 +301,24 @@ struct SCPUState
 	uint32	PBPCAtOpcodeStart;
 	uint32	AutoSaveTimer;
 	bool8	SRAMModified;
+#ifndef SNSFOPT_REMOVED
+	uint32	IdleLoopPBPC;
+	int32	IdleLoopCycles;
+	bool8	IdleLoopTainted;
+	uint32	IdleLoopCoverage;
+	struct SRegisters	IdleLoopRegisters;
+	uint8	IdleLoopFlags[4];
+	uint8	IdleLoopOpenBus;
+	bool8	IdleLoopWaiting;
+	int32	IdleLoopReadCount;
+	int32	IdleLoopReadCycles[IDLE_LOOP_MAX_READS];
+	uint16	IdleLoopReadAddress[IDLE_LOOP_MAX_READS];
+	uint8	IdleLoopReadValue[IDLE_LOOP_MAX_READS];
+	int32	IdleLoopPortQueueLength;
+	int32	IdleLoopPortQueuePos;
+	uint8	IdleLoopPortQueue[IDLE_LOOP_MAX_READS];
+	uint64	IdleLoopSkippedCycles;
+#endif
 };
 
 enum
@@ -445,6 +466,10 @@ struct SSettings
 	bool8	UpAndDown;
 
 	bool8	OpenGLEnable;
+
+#ifndef SNSFOPT_REMOVED
+	bool8	AudioOnly;	// DMA/HDMA from memory to VRAM, CGRAM or OAM only takes its time
+#endif
 };
 
 struct SSNESGameFixes
@@ -470,10 +495,15 @@ void S9xClearPause(uint32);
 void S9xExit(void);
 void S9xMessage(int, int, const char *);
 
-extern struct SSettings			Settings;
-extern struct SCPUState			CPU;
-extern struct STimings			Timings;
-extern struct SSNESGameFixes	SNESGameFixes;
-extern char						String[513];
+extern THREAD_LOCAL struct SSettings			*S9xSettings;
+extern THREAD_LOCAL struct SCPUState		*S9xCPU;
+extern THREAD_LOCAL struct STimings			*S9xTimings;
+extern THREAD_LOCAL struct SSNESGameFixes	*S9xSNESGameFixes;
+extern THREAD_LOCAL char					String[513];
+
+#define Settings		(*S9xSettings)
+#define CPU				(*S9xCPU)
+#define Timings			(*S9xTimings)
+#define SNESGameFixes	(*S9xSNESGameFixes)
 
 #endif
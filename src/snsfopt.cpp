@@ -5,8 +5,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <limits.h>
 #include <time.h>
 #include <math.h>
+#include <stdarg.h>
 
 #include <string>
 #include <map>
@@ -14,6 +16,11 @@
 #include <iterator>
 #include <limits>
 #include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <zlib.h>
 
 #include "snsfopt.h"
 #include "cpath.h"
@@ -24,8 +31,6 @@
 #include <Windows.h>
 #include <direct.h>
 #include <float.h>
-#define getcwd _getcwd
-#define chdir _chdir
 #define isnan _isnan
 #define strcasecmp _stricmp
 #else
@@ -48,7 +53,28 @@
 
 #define SNES_APU_RAM_SIZE	0x10000
 
+// 64-bit FNV-1a, which tells games and options apart in the warm boot cache
+#define FNV1A_64_INIT	0xcbf29ce484222325ULL
+
+static uint64_t HashBytes(uint64_t hash, const void * data, size_t size)
+{
+	const uint8_t * bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+template<typename T>
+static uint64_t HashValue(uint64_t hash, const T & value)
+{
+	return HashBytes(hash, &value, sizeof(T));
+}
+
 SnsfOpt::SnsfOpt() :
+	snsf_base_offset(0),
 	rom_bytes_used(0),
 	apuram_bytes_used(0),
 	optimize_timeout(10.0),
@@ -57,17 +83,51 @@ SnsfOpt::SnsfOpt() :
 	target_loop_count(2),
 	loop_verify_length(20.0),
 	oneshot_verify_length(15),
+	oneshot_guard_length(0.0),
+	checkpoint_valid(false),
+	checkpoint_resumed(false),
+	checkpoint_abandoned(false),
+	checkpoint_trigger_offset(0),
+	checkpoint_trigger_size(0),
+	spc_dump_count(0),
+	spc_dump_captured(false),
+	spc_snapshot_time(0.0),
+	spc_wipe_length(0.0),
+	spc_wiped_size(0),
+	compare_pass(0),
+	compare_length(0.0),
+	compare_samples(0),
+	compare_start_time(0.0),
 	paranoid_closed_area_fill_size(1),
 	paranoid_post_fill_size(0),
-	snsf_base_offset(0),
-	spc_snapshot_dumped(NULL),
 	DelayedSPCDump(false),
-	FixROMChecksum(false)
+	FixROMChecksum(false),
+	ShowIdleLoopStats(false),
+	warm_boot_length(2.0),
+	game_hash(0),
+	run_from_reset(false),
+	warm_boot_pending(false),
+	warm_boot_hit(false),
+	warm_boot_time(0.0),
+	warm_boot_max_idle(0.0),
+	apu_log_pos(0),
+	apu_log_frame(0),
+	apu_log_recording(false),
+	apu_log_replaying(false),
+	apu_log_replay_time(0.0),
+	console_out(NULL),
+	console_err(NULL)
 {
 	m_system = new SNESSystem;
 	rom_refs = new uint8_t[SNES_HEADER_SIZE + MAX_SNES_ROM_SIZE];
 	apuram_refs = new uint8_t[SNES_APU_RAM_SIZE];
 
+	for (int i = 0; i < 2; i++)
+	{
+		compare_elapsed[i] = 0.0;
+		compare_rom_bytes[i] = 0;
+	}
+
 	ResetOptimizer();
 }
 
@@ -89,10 +149,85 @@ SnsfOpt::~SnsfOpt()
 		delete[] apuram_refs;
 	}
 
-	if (spc_snapshot_dumped != NULL)
+	ClearSPCSnapshots();
+}
+
+void SnsfOpt::CopySettings(const SnsfOpt & src)
+{
+	optimize_timeout = src.optimize_timeout;
+	optimize_progress_frequency = src.optimize_progress_frequency;
+	time_loop_based = src.time_loop_based;
+	target_loop_count = src.target_loop_count;
+	loop_verify_length = src.loop_verify_length;
+	oneshot_verify_length = src.oneshot_verify_length;
+	oneshot_guard_length = src.oneshot_guard_length;
+	paranoid_closed_area_fill_size = src.paranoid_closed_area_fill_size;
+	paranoid_post_fill_size = src.paranoid_post_fill_size;
+	snsf_base_offset = src.snsf_base_offset;
+	DelayedSPCDump = src.DelayedSPCDump;
+	spc_wipe_length = src.spc_wipe_length;
+	spc_capture_times = src.spc_capture_times;
+	spc_capture_key_ons = src.spc_capture_key_ons;
+	FixROMChecksum = src.FixROMChecksum;
+	ShowIdleLoopStats = src.ShowIdleLoopStats;
+	warm_boot_dir = src.warm_boot_dir;
+	warm_boot_length = src.warm_boot_length;
+	apu_log_dir = src.apu_log_dir;
+	m_system->SetAudioOnly(src.m_system->GetAudioOnly());
+}
+
+void SnsfOpt::SetConsoleBuffer(std::string * out, std::string * err)
+{
+	console_out = out;
+	console_err = err;
+}
+
+static void AppendFormatV(std::string & str, const char * format, va_list args)
+{
+	va_list args_copy;
+	va_copy(args_copy, args);
+	int len = vsnprintf(NULL, 0, format, args_copy);
+	va_end(args_copy);
+
+	if (len <= 0)
+	{
+		return;
+	}
+
+	size_t offset = str.size();
+	str.resize(offset + len + 1);
+	vsnprintf(&str[offset], len + 1, format, args);
+	str.resize(offset + len);
+}
+
+void SnsfOpt::Print(const char * format, ...) const
+{
+	va_list args;
+	va_start(args, format);
+	if (console_out != NULL)
+	{
+		AppendFormatV(*console_out, format, args);
+	}
+	else
+	{
+		vprintf(format, args);
+	}
+	va_end(args);
+}
+
+void SnsfOpt::PrintError(const char * format, ...) const
+{
+	va_list args;
+	va_start(args, format);
+	if (console_err != NULL)
 	{
-		delete spc_snapshot_dumped;
+		AppendFormatV(*console_err, format, args);
 	}
+	else
+	{
+		vfprintf(stderr, format, args);
+	}
+	va_end(args);
 }
 
 std::string SnsfOpt::ToTimeString(double t, bool padding)
@@ -238,6 +373,8 @@ bool SnsfOpt::LoadROM(const uint8_t * rom, uint32_t romsize, const uint8_t * sra
 		m_system->Term();
 	}
 
+	ClearCheckpoint();
+
 	m_system->Load(rom, romsize, sram, sramsize);
 
 	m_system->SoundInit(&m_output);
@@ -246,6 +383,10 @@ bool SnsfOpt::LoadROM(const uint8_t * rom, uint32_t romsize, const uint8_t * sra
 	m_system->Init();
 	m_system->Reset();
 
+	game_hash = HashBytes(HashValue(FNV1A_64_INIT, romsize), rom, romsize);
+	game_hash = HashBytes(HashValue(game_hash, sramsize), sram, sramsize);
+	run_from_reset = true;
+
 	ResetOptimizerVariables();
 	return true;
 }
@@ -347,6 +488,67 @@ bool SnsfOpt::LoadROMFile(const std::string& filename)
 	return load_result;
 }
 
+bool SnsfOpt::LoadSPCFile(const std::string& filename)
+{
+	FILE *fp = NULL;
+	off_t filesize;
+
+	filesize = path_getfilesize(filename.c_str());
+	if (filesize <= 0)
+	{
+		m_message = filename + " - " + "File not found";
+		return false;
+	}
+
+	fp = fopen(filename.c_str(), "rb");
+	if (fp == NULL)
+	{
+		m_message = filename + " - " + "File open error";
+		return false;
+	}
+
+	std::vector<uint8_t> spc_buf(filesize);
+	if (fread(spc_buf.data(), 1, filesize, fp) != (size_t)filesize)
+	{
+		m_message = filename + " - " + "Unable to load SPC data";
+		fclose(fp);
+		return false;
+	}
+	fclose(fp);
+
+	if (m_system->IsLoaded())
+	{
+		MergeRefs(rom_refs, m_system->GetROMCoverage(), GetROMSize());
+		m_system->Term();
+	}
+
+	ClearCheckpoint();
+
+	if (!m_system->LoadSPC(spc_buf.data(), (uint32_t)filesize))
+	{
+		m_message = filename + " - " + "Invalid SPC file";
+		return false;
+	}
+
+	m_system->SoundInit(&m_output);
+	m_output.reset_timer();
+
+	char tmppath[PATH_MAX];
+
+	path_getabspath(filename.c_str(), tmppath);
+	rom_path = tmppath;
+
+	path_basename(tmppath);
+	rom_filename = tmppath;
+
+	// only the APU runs, there is no reset to warm boot from or 65c816 to log
+	game_hash = HashBytes(HashValue(FNV1A_64_INIT, (uint32_t)filesize), spc_buf.data(), filesize);
+	run_from_reset = false;
+
+	ResetOptimizerVariables();
+	return true;
+}
+
 void SnsfOpt::PatchROM(uint32_t offset, const void * data, uint32_t size, bool apply_base_offset)
 {
 	if (!m_system->IsLoaded())
@@ -371,6 +573,8 @@ void SnsfOpt::PatchROM(uint32_t offset, const void * data, uint32_t size, bool a
 	}
 
 	m_system->WriteROM(data, size, offset);
+
+	game_hash = HashBytes(HashValue(HashValue(game_hash, offset), size), data, size);
 }
 
 void SnsfOpt::ResetGame()
@@ -383,164 +587,633 @@ void SnsfOpt::ResetGame()
 	MergeRefs(rom_refs, m_system->GetROMCoverage(), GetROMSize());
 	m_system->Reset();
 	m_output.reset_timer();
+	run_from_reset = true;
 }
 
-bool SnsfOpt::ReadSNSFFile(const std::string& filename, unsigned int nesting_level, uint8_t * rom_buf, uint32_t * ptr_rom_size, uint8_t * sram_buf, uint32_t * ptr_sram_size, uint32_t * ptr_base_offset)
+void SnsfOpt::SetCheckpointTrigger(uint32_t offset, uint32_t size, bool apply_base_offset)
 {
-	bool result;
+	ClearCheckpoint();
 
-	if (ptr_base_offset == NULL)
+	if (apply_base_offset)
 	{
-		m_message = filename + " - " + "Internal error (base offset must not be null)";
-		return false;
+		offset += snsf_base_offset;
 	}
 
-	// end the nesting hell up
-	if (nesting_level > 10)
+	if (offset >= MAX_SNES_ROM_SIZE)
 	{
-		m_message = filename + " - " + "Too many snsflibs";
-		return false;
+		return;
 	}
-
-	// change base directory
-	char savedcwd[PATH_MAX];
-	getcwd(savedcwd, PATH_MAX);
-	char snsf_dir[PATH_MAX];
-	strcpy(snsf_dir, filename.c_str());
-	path_dirname(snsf_dir);
-	if (snsf_dir[0] != '\0')
+	if (offset + size > MAX_SNES_ROM_SIZE)
 	{
-		chdir(snsf_dir);
+		size = MAX_SNES_ROM_SIZE - offset;
 	}
 
-	// open SNSF file
-	PSFFile * snsf = PSFFile::load(filename);
-	if (snsf == NULL)
+	checkpoint_trigger_offset = offset;
+	checkpoint_trigger_size = size;
+}
+
+void SnsfOpt::ClearCheckpoint(void)
+{
+	checkpoint_valid = false;
+	checkpoint_resumed = false;
+	checkpoint_abandoned = false;
+	checkpoint_trigger_offset = 0;
+	checkpoint_trigger_size = 0;
+
+	// release the memory as well
+	std::vector<uint8_t>().swap(checkpoint.state);
+	std::vector<uint8_t>().swap(checkpoint_candidate.state);
+}
+
+void SnsfOpt::ResumeGame(void)
+{
+	if (!m_system->IsLoaded())
 	{
-		m_message = filename + " - " + "PSF load error";
-		chdir(savedcwd);
-		return false;
+		return;
 	}
 
-	// check version code
-	if (snsf->version != SNSF_PSF_VERSION)
+	if (!checkpoint_valid)
 	{
-		m_message = filename + " - " + "Mismatch PSF version";
-		chdir(savedcwd);
-		return false;
+		ResetGame();
+		return;
 	}
 
-	// top-level initialization
-	if (nesting_level == 0)
+	MergeRefs(rom_refs, m_system->GetROMCoverage(), GetROMSize());
+	if (!m_system->LoadState(checkpoint.state.data(), (uint32_t)checkpoint.state.size()))
 	{
-		if (ptr_rom_size != NULL)
-		{
-			*ptr_rom_size = 0;
-		}
+		// should not happen with the same game loaded, but booting is always safe
+		checkpoint_valid = false;
+		m_system->Reset();
+		m_output.reset_timer();
+		run_from_reset = true;
+		return;
+	}
+	m_output = checkpoint.output;
 
-		if (ptr_sram_size != NULL)
-		{
-			*ptr_sram_size = 0;
-		}
+	// Run() takes the optimizer variables after its start callback
+	checkpoint_resumed = true;
+}
 
-		// invalidate the base offset
-		*ptr_base_offset = 0xffffffff;
+// Emulated time after which the checkpoint capture gives up on the trigger
+#define CHECKPOINT_CAPTURE_LENGTH	30.0
+
+void SnsfOpt::SaveCheckpoint(checkpoint_t & cp)
+{
+	cp.state.resize(m_system->GetStateSize());
+	m_system->SaveState(cp.state.data(), (uint32_t)cp.state.size());
+	cp.output = m_output;
+
+	memcpy(cp.rom_refs_histogram, rom_refs_histogram, sizeof(rom_refs_histogram));
+	memcpy(cp.apuram_refs_histogram, apuram_refs_histogram, sizeof(apuram_refs_histogram));
+	cp.song_endpoint = song_endpoint;
+	cp.optimize_endpoint = optimize_endpoint;
+	cp.time_last_new_data = time_last_new_data;
+	memcpy(cp.loop_point_raw, loop_point_raw, sizeof(loop_point_raw));
+	memcpy(cp.loop_point, loop_point, sizeof(loop_point));
+	memcpy(cp.loop_point_updated, loop_point_updated, sizeof(loop_point_updated));
+	cp.loop_count = loop_count;
+	cp.oneshot_endpoint = oneshot_endpoint;
+	cp.oneshot = oneshot;
+	cp.initial_silence_length = initial_silence_length;
+	cp.voice_activity_end = voice_activity_end;
+}
+
+void SnsfOpt::RestoreCheckpointVariables(const checkpoint_t & cp)
+{
+	memcpy(rom_refs_histogram, cp.rom_refs_histogram, sizeof(rom_refs_histogram));
+	memcpy(apuram_refs_histogram, cp.apuram_refs_histogram, sizeof(apuram_refs_histogram));
+	song_endpoint = cp.song_endpoint;
+	optimize_endpoint = cp.optimize_endpoint;
+	time_last_new_data = cp.time_last_new_data;
+	memcpy(loop_point_raw, cp.loop_point_raw, sizeof(loop_point_raw));
+	memcpy(loop_point, cp.loop_point, sizeof(loop_point));
+	memcpy(loop_point_updated, cp.loop_point_updated, sizeof(loop_point_updated));
+	loop_count = cp.loop_count;
+	oneshot_endpoint = cp.oneshot_endpoint;
+	oneshot = cp.oneshot;
+	initial_silence_length = cp.initial_silence_length;
+	voice_activity_end = cp.voice_activity_end;
+}
+
+#define WARM_BOOT_MAGIC		"SNSFWARM"
+#define WARM_BOOT_VERSION	6
+
+template<typename T>
+static bool WriteValue(FILE * fp, const T & value)
+{
+	return fwrite(&value, sizeof(T), 1, fp) == 1;
+}
+
+template<typename T>
+static bool ReadValue(FILE * fp, T & value)
+{
+	return fread(&value, sizeof(T), 1, fp) == 1;
+}
+
+void SnsfOpt::SetWarmBootCache(const std::string & dir, double warmup)
+{
+	warm_boot_dir = dir;
+	warm_boot_length = warmup;
+}
+
+static std::string GetCachePath(const std::string & dir, uint64_t hash, const char * ext)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.%s", (unsigned long long)hash, ext);
+
+	std::string path = dir;
+	if (!path.empty() && path[path.size() - 1] != PATH_SEPARATOR_CHAR)
+	{
+		path += PATH_SEPARATOR_STR;
 	}
+	return path + name;
+}
 
-	// handle _lib file
-	std::map<std::string, std::string>::iterator it_lib = snsf->tags.lower_bound("_lib");
-	bool has_lib = (it_lib != snsf->tags.end() && it_lib->first == "_lib");
-	if (has_lib)
+std::string SnsfOpt::GetWarmBootPath(void) const
+{
+	// the timeout is left out; LoadWarmBoot() checks it against the entry instead
+	uint64_t hash = HashBytes(game_hash, APP_VER, strlen(APP_VER));
+	hash = HashValue(hash, m_system->GetStateVersion());
+	hash = HashValue(hash, m_system->GetStateSize());
+	hash = HashValue(hash, m_system->GetDSPResetAccuracy());
+	hash = HashValue(hash, m_system->GetAudioOnly());
+	hash = HashValue(hash, warm_boot_length);
+	hash = HashValue(hash, time_loop_based);
+	hash = HashValue(hash, target_loop_count);
+	hash = HashValue(hash, loop_verify_length);
+	hash = HashValue(hash, oneshot_verify_length);
+	hash = HashValue(hash, oneshot_guard_length);
+	return GetCachePath(warm_boot_dir, hash, "warm");
+}
+
+bool SnsfOpt::SaveWarmBoot(void)
+{
+	checkpoint_t cp;
+	SaveCheckpoint(cp);
+
+	uLongf packed_size = compressBound((uLong)cp.state.size());
+	std::vector<uint8_t> packed(packed_size);
+	if (compress2(packed.data(), &packed_size, cp.state.data(), (uLong)cp.state.size(), 1) != Z_OK)
 	{
-		if (!ReadSNSFFile(it_lib->second, nesting_level + 1, rom_buf, ptr_rom_size, sram_buf, ptr_sram_size, ptr_base_offset))
-		{
-			delete snsf;
-			chdir(savedcwd);
-			return false;
-		}
+		return false;
 	}
 
-	// SNSF EXE header
-	uint32_t rom_address;
-	uint32_t rom_size;
-	result = true;
-	result &= snsf->compressed_exe.readInt(rom_address);
-	result &= snsf->compressed_exe.readInt(rom_size);
-	if (!result)
+	// write to a temporary file first, other processes may be reading the entry
+	std::string path = GetWarmBootPath();
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%p.tmp", (void *)this);
+	std::string temp_path = path + suffix;
+
+	FILE * fp = fopen(temp_path.c_str(), "wb");
+	if (fp == NULL)
 	{
-		m_message = filename + " - " + "Read error at SNSF EXE header";
-		delete snsf;
-		chdir(savedcwd);
 		return false;
 	}
 
-	// valid load address?
-	uint32_t rom_offset;
-	rom_offset = rom_address & 0x1FFFFFF;
+	bool result = (fwrite(WARM_BOOT_MAGIC, 8, 1, fp) == 1);
+	result &= WriteValue(fp, (uint32_t)WARM_BOOT_VERSION);
+	result &= WriteValue(fp, warm_boot_max_idle);
+
+	result &= WriteValue(fp, cp.output.samples_received);
+	result &= WriteValue(fp, cp.output.silent_samples_received);
+	result &= WriteValue(fp, cp.output.silence_start);
+	result &= WriteValue(fp, cp.output.initial_silence_captured);
+	result &= WriteValue(fp, cp.output.initial_silence_samples);
+
+	result &= WriteValue(fp, cp.rom_refs_histogram);
+	result &= WriteValue(fp, cp.apuram_refs_histogram);
+	result &= WriteValue(fp, cp.song_endpoint);
+	result &= WriteValue(fp, cp.optimize_endpoint);
+	result &= WriteValue(fp, cp.time_last_new_data);
+	result &= WriteValue(fp, cp.loop_point_raw);
+	result &= WriteValue(fp, cp.loop_point);
+	result &= WriteValue(fp, cp.loop_point_updated);
+	result &= WriteValue(fp, cp.loop_count);
+	result &= WriteValue(fp, cp.oneshot_endpoint);
+	result &= WriteValue(fp, cp.oneshot);
+	result &= WriteValue(fp, cp.initial_silence_length);
+	result &= WriteValue(fp, cp.voice_activity_end);
+
+	result &= WriteValue(fp, (uint32_t)cp.state.size());
+	result &= WriteValue(fp, (uint32_t)packed_size);
+	result &= (fwrite(packed.data(), 1, packed_size, fp) == packed_size);
+	result &= (fclose(fp) == 0);
+
+	if (result && rename(temp_path.c_str(), path.c_str()) == 0)
+	{
+		return true;
+	}
 
-	// first snsf/snsflib?
-	if (*ptr_base_offset == 0xffffffff)
+	remove(temp_path.c_str());
+	return false;
+}
+
+bool SnsfOpt::LoadWarmBoot(void)
+{
+	FILE * fp = fopen(GetWarmBootPath().c_str(), "rb");
+	if (fp == NULL)
 	{
-		if (rom_offset > 0xff00) // should be 0x7f00 for LoROM, but I don't care
-		{
-			m_message = filename + " - " + "Base offset out of range";
+		return false;
+	}
 
-			delete snsf;
-			chdir(savedcwd);
-			return false;
-		}
+	checkpoint_t cp;
+	char magic[8];
+	uint32_t version = 0;
+	double max_idle = 0.0;
+	uint32_t state_size = 0;
+	uint32_t packed_size = 0;
 
-		*ptr_base_offset = rom_offset;
+	bool result = (fread(magic, 8, 1, fp) == 1 && memcmp(magic, WARM_BOOT_MAGIC, 8) == 0);
+	result = result && ReadValue(fp, version) && version == WARM_BOOT_VERSION;
+	result = result && ReadValue(fp, max_idle);
+
+	result = result && ReadValue(fp, cp.output.samples_received);
+	result = result && ReadValue(fp, cp.output.silent_samples_received);
+	result = result && ReadValue(fp, cp.output.silence_start);
+	result = result && ReadValue(fp, cp.output.initial_silence_captured);
+	result = result && ReadValue(fp, cp.output.initial_silence_samples);
+
+	result = result && ReadValue(fp, cp.rom_refs_histogram);
+	result = result && ReadValue(fp, cp.apuram_refs_histogram);
+	result = result && ReadValue(fp, cp.song_endpoint);
+	result = result && ReadValue(fp, cp.optimize_endpoint);
+	result = result && ReadValue(fp, cp.time_last_new_data);
+	result = result && ReadValue(fp, cp.loop_point_raw);
+	result = result && ReadValue(fp, cp.loop_point);
+	result = result && ReadValue(fp, cp.loop_point_updated);
+	result = result && ReadValue(fp, cp.loop_count);
+	result = result && ReadValue(fp, cp.oneshot_endpoint);
+	result = result && ReadValue(fp, cp.oneshot);
+	result = result && ReadValue(fp, cp.initial_silence_length);
+	result = result && ReadValue(fp, cp.voice_activity_end);
+
+	result = result && ReadValue(fp, state_size) && state_size == m_system->GetStateSize();
+	result = result && ReadValue(fp, packed_size);
+
+	// the entry was taken with a longer timeout than this run may have; it is
+	// only valid if the run would not have finished during the warm-up
+	if (!time_loop_based && max_idle >= optimize_timeout)
+	{
+		result = false;
 	}
-	else
+
+	std::vector<uint8_t> packed;
+	if (result)
 	{
-		rom_offset += *ptr_base_offset;
+		packed.resize(packed_size);
+		result = (fread(packed.data(), 1, packed_size, fp) == packed_size);
 	}
+	fclose(fp);
 
-	// check offset and size
-	if (rom_offset + rom_size > (size_t)SNES_HEADER_SIZE + MAX_SNES_ROM_SIZE)
+	if (result)
 	{
-		m_message = filename + " - " + "ROM size error";
+		uLongf unpacked_size = state_size;
+		cp.state.resize(state_size);
+		result = (uncompress(cp.state.data(), &unpacked_size, packed.data(), packed_size) == Z_OK && unpacked_size == state_size);
+	}
 
-		delete snsf;
-		chdir(savedcwd);
+	if (!result || !m_system->LoadState(cp.state.data(), state_size))
+	{
 		return false;
 	}
 
-	// update ROM size
-	if (ptr_rom_size != NULL)
+	m_output.samples_received = cp.output.samples_received;
+	m_output.silent_samples_received = cp.output.silent_samples_received;
+	m_output.silence_start = cp.output.silence_start;
+	m_output.initial_silence_captured = cp.output.initial_silence_captured;
+	m_output.initial_silence_samples = cp.output.initial_silence_samples;
+	RestoreCheckpointVariables(cp);
+	return true;
+}
+
+#define APU_LOG_MAGIC		"SNSFAPUL"
+#define APU_LOG_VERSION		2
+
+void SnsfOpt::SetAPULogCache(const std::string & dir)
+{
+	apu_log_dir = dir;
+}
+
+std::string SnsfOpt::GetAPULogPath(void) const
+{
+	// the loop and silence options are left out, the log only depends on the emulation
+	uint64_t hash = HashBytes(game_hash, APP_VER, strlen(APP_VER));
+	hash = HashValue(hash, m_system->GetStateVersion());
+	hash = HashValue(hash, m_system->GetStateSize());
+	hash = HashValue(hash, m_system->GetAPUStateSize());
+	hash = HashValue(hash, m_system->GetDSPResetAccuracy());
+	hash = HashValue(hash, m_system->GetAudioOnly());
+	return GetCachePath(apu_log_dir, hash, "apulog");
+}
+
+bool SnsfOpt::SaveAPULog(void)
+{
+	// the whole system at the end of the log, to go on from there
+	apu_log_end_state.resize(m_system->GetStateSize());
+	if (!m_system->SaveState(apu_log_end_state.data(), (uint32_t)apu_log_end_state.size()))
 	{
-		if (*ptr_rom_size < rom_offset + rom_size)
-		{
-			*ptr_rom_size = rom_offset + rom_size;
-		}
+		return false;
 	}
 
-	// load ROM data
-	if (snsf->compressed_exe.read(&rom_buf[rom_offset], rom_size) != rom_size)
+	const std::vector<uint8_t> * parts[4] = { &apu_log_start_state, &apu_log, &apu_log_rom_loops, &apu_log_end_state };
+	std::vector<uint8_t> data;
+	for (int i = 0; i < 4; i++)
 	{
-		m_message = filename + " - " + "Unable to load ROM data";
+		data.insert(data.end(), parts[i]->begin(), parts[i]->end());
+	}
 
-		delete snsf;
-		chdir(savedcwd);
+	uLongf packed_size = compressBound((uLong)data.size());
+	std::vector<uint8_t> packed(packed_size);
+	if (compress2(packed.data(), &packed_size, data.data(), (uLong)data.size(), 1) != Z_OK)
+	{
 		return false;
 	}
 
-	// reserved section
-	if (snsf->reserved.size() > 8)
+	// write to a temporary file first, other processes may be reading the entry
+	std::string path = GetAPULogPath();
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%p.tmp", (void *)this);
+	std::string temp_path = path + suffix;
+
+	FILE * fp = fopen(temp_path.c_str(), "wb");
+	if (fp == NULL)
 	{
-		uint32_t reserve_type = snsf->reserved[0] | (snsf->reserved[1] << 8) | (snsf->reserved[2] << 16) | (snsf->reserved[3] << 24);
-		uint32_t reserve_size = snsf->reserved[4] | (snsf->reserved[5] << 8) | (snsf->reserved[6] << 16) | (snsf->reserved[7] << 24);
+		return false;
+	}
 
-		if (reserve_type == 0)
-		{
-			// SRAM block
-			if (reserve_size < 4)
-			{
-				m_message = filename + " - " + "Reserve section (SRAM) is too short";
+	bool result = (fwrite(APU_LOG_MAGIC, 8, 1, fp) == 1);
+	result &= WriteValue(fp, (uint32_t)APU_LOG_VERSION);
+	for (int i = 0; i < 4; i++)
+	{
+		result &= WriteValue(fp, (uint32_t)parts[i]->size());
+	}
+	result &= WriteValue(fp, (uint32_t)packed_size);
+	result &= (fwrite(packed.data(), 1, packed_size, fp) == packed_size);
+	result &= (fclose(fp) == 0);
 
-				delete snsf;
-				chdir(savedcwd);
+	if (result && rename(temp_path.c_str(), path.c_str()) == 0)
+	{
+		return true;
+	}
+
+	remove(temp_path.c_str());
+	return false;
+}
+
+bool SnsfOpt::LoadAPULog(void)
+{
+	FILE * fp = fopen(GetAPULogPath().c_str(), "rb");
+	if (fp == NULL)
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> * parts[4] = { &apu_log_start_state, &apu_log, &apu_log_rom_loops, &apu_log_end_state };
+	char magic[8];
+	uint32_t version = 0;
+	uint32_t sizes[4] = { 0, 0, 0, 0 };
+	uint32_t packed_size = 0;
+
+	bool result = (fread(magic, 8, 1, fp) == 1 && memcmp(magic, APU_LOG_MAGIC, 8) == 0);
+	result = result && ReadValue(fp, version) && version == APU_LOG_VERSION;
+	for (int i = 0; i < 4; i++)
+	{
+		result = result && ReadValue(fp, sizes[i]);
+	}
+	result = result && ReadValue(fp, packed_size);
+	result = result && sizes[0] == m_system->GetAPUStateSize() && sizes[3] == m_system->GetStateSize();
+
+	std::vector<uint8_t> packed;
+	if (result)
+	{
+		packed.resize(packed_size);
+		result = (fread(packed.data(), 1, packed_size, fp) == packed_size);
+	}
+	fclose(fp);
+
+	std::vector<uint8_t> data;
+	if (result)
+	{
+		uLongf unpacked_size = (uLongf)sizes[0] + sizes[1] + sizes[2] + sizes[3];
+		data.resize(unpacked_size);
+		result = (uncompress(data.data(), &unpacked_size, packed.data(), packed_size) == Z_OK && unpacked_size == data.size());
+	}
+
+	if (!result)
+	{
+		return false;
+	}
+
+	size_t offset = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		parts[i]->assign(data.begin() + offset, data.begin() + offset + sizes[i]);
+		offset += sizes[i];
+	}
+	return true;
+}
+
+void SnsfOpt::RunFrame(void)
+{
+	if (apu_log_replaying)
+	{
+		if (apu_log_frame < apu_log_rom_loops.size() && m_system->ReplayAPUFrame(apu_log, apu_log_pos))
+		{
+			apu_log_frame++;
+			m_output.end_frame();
+			return;
+		}
+
+		// the log ends here, so go on with the whole system from its final state
+		// and keep logging from there
+		apu_log_replaying = false;
+		apu_log_replay_time = m_output.get_timer();
+		if (m_system->LoadState(apu_log_end_state.data(), (uint32_t)apu_log_end_state.size()))
+		{
+			memcpy(rom_refs_histogram, m_system->GetROMCoverageHistogram(), sizeof(rom_refs_histogram));
+			apu_log.resize(apu_log_pos);
+			apu_log_rom_loops.resize(apu_log_frame);
+			apu_log_recording = m_system->SetAPULog(&apu_log);
+		}
+		std::vector<uint8_t>().swap(apu_log_end_state);
+	}
+
+	m_system->CPULoop();
+	m_output.end_frame();
+}
+
+bool SnsfOpt::IsCheckpointTriggered(void) const
+{
+	const uint8_t * coverage = m_system->GetROMCoverage();
+	for (uint32_t i = 0; i < checkpoint_trigger_size; i++)
+	{
+		if (coverage[m_system->GetMemoryOffset(checkpoint_trigger_offset + i)] != 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static std::string GetLibraryPath(const std::string& snsf_path, const std::string& lib_name)
+{
+	const char * snsf_basename = path_findbase(snsf_path.c_str());
+	if (snsf_basename == snsf_path.c_str())
+	{
+		return lib_name;
+	}
+
+#ifdef WIN32
+	if (!PathIsRelativeA(lib_name.c_str()))
+#else
+	if (lib_name[0] == PATH_SEPARATOR_CHAR)
+#endif
+	{
+		return lib_name;
+	}
+
+	return std::string(snsf_path.c_str(), snsf_basename - snsf_path.c_str()) + lib_name;
+}
+
+bool SnsfOpt::ReadSNSFFile(const std::string& filename, unsigned int nesting_level, uint8_t * rom_buf, uint32_t * ptr_rom_size, uint8_t * sram_buf, uint32_t * ptr_sram_size, uint32_t * ptr_base_offset)
+{
+	bool result;
+
+	if (ptr_base_offset == NULL)
+	{
+		m_message = filename + " - " + "Internal error (base offset must not be null)";
+		return false;
+	}
+
+	// end the nesting hell up
+	if (nesting_level > 10)
+	{
+		m_message = filename + " - " + "Too many snsflibs";
+		return false;
+	}
+
+	// open SNSF file
+	PSFFile * snsf = PSFFile::load(filename);
+	if (snsf == NULL)
+	{
+		m_message = filename + " - " + "PSF load error";
+		return false;
+	}
+
+	// check version code
+	if (snsf->version != SNSF_PSF_VERSION)
+	{
+		m_message = filename + " - " + "Mismatch PSF version";
+		return false;
+	}
+
+	// top-level initialization
+	if (nesting_level == 0)
+	{
+		if (ptr_rom_size != NULL)
+		{
+			*ptr_rom_size = 0;
+		}
+
+		if (ptr_sram_size != NULL)
+		{
+			*ptr_sram_size = 0;
+		}
+
+		// invalidate the base offset
+		*ptr_base_offset = 0xffffffff;
+	}
+
+	// handle _lib file
+	// (paths are resolved against the parent file rather than by changing
+	// the working directory, other instances may be loading files too)
+	std::map<std::string, std::string>::iterator it_lib = snsf->tags.lower_bound("_lib");
+	bool has_lib = (it_lib != snsf->tags.end() && it_lib->first == "_lib");
+	if (has_lib)
+	{
+		if (!ReadSNSFFile(GetLibraryPath(filename, it_lib->second), nesting_level + 1, rom_buf, ptr_rom_size, sram_buf, ptr_sram_size, ptr_base_offset))
+		{
+			delete snsf;
+			return false;
+		}
+	}
+
+	// SNSF EXE header
+	uint32_t rom_address;
+	uint32_t rom_size;
+	result = true;
+	result &= snsf->compressed_exe.readInt(rom_address);
+	result &= snsf->compressed_exe.readInt(rom_size);
+	if (!result)
+	{
+		m_message = filename + " - " + "Read error at SNSF EXE header";
+		delete snsf;
+		return false;
+	}
+
+	// valid load address?
+	uint32_t rom_offset;
+	rom_offset = rom_address & 0x1FFFFFF;
+
+	// first snsf/snsflib?
+	if (*ptr_base_offset == 0xffffffff)
+	{
+		if (rom_offset > 0xff00) // should be 0x7f00 for LoROM, but I don't care
+		{
+			m_message = filename + " - " + "Base offset out of range";
+
+			delete snsf;
+			return false;
+		}
+
+		*ptr_base_offset = rom_offset;
+	}
+	else
+	{
+		rom_offset += *ptr_base_offset;
+	}
+
+	// check offset and size
+	if (rom_offset + rom_size > (size_t)SNES_HEADER_SIZE + MAX_SNES_ROM_SIZE)
+	{
+		m_message = filename + " - " + "ROM size error";
+
+		delete snsf;
+		return false;
+	}
+
+	// update ROM size
+	if (ptr_rom_size != NULL)
+	{
+		if (*ptr_rom_size < rom_offset + rom_size)
+		{
+			*ptr_rom_size = rom_offset + rom_size;
+		}
+	}
+
+	// load ROM data
+	if (snsf->compressed_exe.read(&rom_buf[rom_offset], rom_size) != rom_size)
+	{
+		m_message = filename + " - " + "Unable to load ROM data";
+
+		delete snsf;
+		return false;
+	}
+
+	// reserved section
+	if (snsf->reserved.size() > 8)
+	{
+		uint32_t reserve_type = snsf->reserved[0] | (snsf->reserved[1] << 8) | (snsf->reserved[2] << 16) | (snsf->reserved[3] << 24);
+		uint32_t reserve_size = snsf->reserved[4] | (snsf->reserved[5] << 8) | (snsf->reserved[6] << 16) | (snsf->reserved[7] << 24);
+
+		if (reserve_type == 0)
+		{
+			// SRAM block
+			if (reserve_size < 4)
+			{
+				m_message = filename + " - " + "Reserve section (SRAM) is too short";
+
+				delete snsf;
 				return false;
 			}
 
@@ -552,7 +1225,6 @@ bool SnsfOpt::ReadSNSFFile(const std::string& filename, unsigned int nesting_lev
 				m_message = filename + " - " + "SRAM size error";
 
 				delete snsf;
-				chdir(savedcwd);
 				return false;
 			}
 
@@ -573,7 +1245,6 @@ bool SnsfOpt::ReadSNSFFile(const std::string& filename, unsigned int nesting_lev
 			m_message = filename + " - " + "Unsupported reserve section type";
 
 			delete snsf;
-			chdir(savedcwd);
 			return false;
 		}
 	}
@@ -581,17 +1252,17 @@ bool SnsfOpt::ReadSNSFFile(const std::string& filename, unsigned int nesting_lev
 	// unsupported tags
 	if (snsf->tags.count("_memory") != 0)
 	{
-		fprintf(stderr, "Warning: _memory tag is not supported\n");
+		PrintError("Warning: _memory tag is not supported\n");
 	}
 
 	if (snsf->tags.count("_video") != 0)
 	{
-		fprintf(stderr, "Warning: _video tag is not supported\n");
+		PrintError("Warning: _video tag is not supported\n");
 	}
 
 	if (snsf->tags.count("_sramfill") != 0)
 	{
-		fprintf(stderr, "Warning: _sramfill tag is not supported\n");
+		PrintError("Warning: _sramfill tag is not supported\n");
 	}
 
 	// handle _libN files
@@ -607,10 +1278,9 @@ bool SnsfOpt::ReadSNSFFile(const std::string& filename, unsigned int nesting_lev
 			break;
 		}
 
-		if (!ReadSNSFFile(it_libN->second, nesting_level + 1, rom_buf, ptr_rom_size, sram_buf, ptr_sram_size, ptr_base_offset))
+		if (!ReadSNSFFile(GetLibraryPath(filename, it_libN->second), nesting_level + 1, rom_buf, ptr_rom_size, sram_buf, ptr_sram_size, ptr_base_offset))
 		{
 			delete snsf;
-			chdir(savedcwd);
 			return false;
 		}
 
@@ -619,12 +1289,17 @@ bool SnsfOpt::ReadSNSFFile(const std::string& filename, unsigned int nesting_lev
 
 	m_message = filename + " - " + "Loaded successfully";
 	delete snsf;
-	chdir(savedcwd);
 	return true;
 }
 
 void SnsfOpt::ResetOptimizer(bool dsp_reset_accuracy)
 {
+	// unload the previous game, or LoadROM would merge its coverage into the cleared refs
+	if (m_system->IsLoaded())
+	{
+		m_system->Term();
+	}
+
 	memset(rom_refs, 0, SNES_HEADER_SIZE + MAX_SNES_ROM_SIZE);
 	memset(rom_refs_histogram, 0, sizeof(rom_refs_histogram));
 	rom_bytes_used = 0;
@@ -642,29 +1317,83 @@ void SnsfOpt::Run(void (SnsfOpt::*Start)(), void (SnsfOpt::*BeforeLoop)(), void
 
 	(this->*Start)();
 
+	if (checkpoint_resumed)
+	{
+		RestoreCheckpointVariables(checkpoint);
+		checkpoint_resumed = false;
+	}
+	else if (warm_boot_pending && LoadWarmBoot())
+	{
+		warm_boot_pending = false;
+		warm_boot_hit = true;
+		warm_boot_time = m_output.get_timer();
+	}
+	run_from_reset = false;
+	warm_boot_max_idle = 0.0;
+
 	double time_last_prog = 0.0;
 	bool finished = false;
 
 	do
 	{
+		// keep the state from the start of each frame, until a frame reads the checkpoint trigger
+		bool capturing = (checkpoint_trigger_size != 0 && !checkpoint_valid && !checkpoint_abandoned);
+		if (capturing && m_output.get_timer() >= CHECKPOINT_CAPTURE_LENGTH)
+		{
+			// the whole state is copied every frame, do not keep doing it for a trigger that may never be read
+			checkpoint_abandoned = true;
+			capturing = false;
+		}
+		if (capturing)
+		{
+			SaveCheckpoint(checkpoint_candidate);
+		}
+
+		if (warm_boot_pending && m_output.get_timer() >= warm_boot_length)
+		{
+			SaveWarmBoot();
+			warm_boot_pending = false;
+		}
+
 		(this->*BeforeLoop)();
 
-		m_system->CPULoop();
+		RunFrame();
+
+		if (capturing && IsCheckpointTriggered())
+		{
+			std::swap(checkpoint, checkpoint_candidate);
+			std::vector<uint8_t>().swap(checkpoint_candidate.state);
+			checkpoint_valid = true;
+		}
 
 		(this->*AfterLoop)();
 
+		if (warm_boot_pending)
+		{
+			warm_boot_max_idle = std::max(warm_boot_max_idle, m_output.get_timer() - time_last_new_data);
+		}
+
 		// is optimization (or loop detection) finished?
 		finished = (this->*Finished)();
 
 		// show progress
 		double time_current = timer_get();
-		if (time_current >= time_last_prog + optimize_progress_frequency)
+		if (console_out == NULL && time_current >= time_last_prog + optimize_progress_frequency)
 		{
 			(this->*ShowProgress)();
 			time_last_prog = time_current;
 		}
 	} while(!finished);
 
+	// a game that did not read the trigger in this run will not read it
+	// for the next song value either
+	if (checkpoint_trigger_size != 0 && !checkpoint_valid)
+	{
+		checkpoint_abandoned = true;
+	}
+	std::vector<uint8_t>().swap(checkpoint_candidate.state);
+	warm_boot_pending = false;
+
 	(this->*End)();
 	(this->*ShowResult)();
 
@@ -673,15 +1402,76 @@ void SnsfOpt::Run(void (SnsfOpt::*Start)(), void (SnsfOpt::*BeforeLoop)(), void
 
 void SnsfOpt::Optimize(void)
 {
+	// only a run straight from reset can use the warm boot cache; the song
+	// value sweep has its own checkpoint
+	warm_boot_hit = false;
+	warm_boot_pending = (!warm_boot_dir.empty() && run_from_reset && checkpoint_trigger_size == 0 && m_system->IsLoaded());
+
+	// ROM optimization only follows the coverage, so the audio is not needed
+	m_system->SetDSPCoverageOnly(!time_loop_based);
+
+	// a timing run from reset is replayed from its APU log, or records one;
+	// the log covers what the warm boot cache would
+	apu_log_pos = 0;
+	apu_log_frame = 0;
+	apu_log_replay_time = 0.0;
+	if (time_loop_based && !apu_log_dir.empty() && run_from_reset && checkpoint_trigger_size == 0 && m_system->IsLoaded())
+	{
+		warm_boot_pending = false;
+
+		if (LoadAPULog())
+		{
+			m_system->LoadAPUState(apu_log_start_state.data());
+			apu_log_replaying = true;
+		}
+		else
+		{
+			apu_log.clear();
+			apu_log_rom_loops.clear();
+			apu_log_start_state.resize(m_system->GetAPUStateSize());
+			m_system->SaveAPUState(apu_log_start_state.data());
+			apu_log_recording = m_system->SetAPULog(&apu_log);
+		}
+	}
+
 	Run(&SnsfOpt::Optimize_Start, &SnsfOpt::Optimize_BeforeLoop, &SnsfOpt::Optimize_AfterLoop, &SnsfOpt::Optimize_Finished, &SnsfOpt::Optimize_End, &SnsfOpt::Optimize_ShowProgress, &SnsfOpt::Optimize_ShowResult);
+
+	if (apu_log_recording)
+	{
+		m_system->SetAPULog(NULL);
+		SaveAPULog();
+	}
+	apu_log_recording = false;
+	apu_log_replaying = false;
+	std::vector<uint8_t>().swap(apu_log);
+	std::vector<uint8_t>().swap(apu_log_rom_loops);
+	std::vector<uint8_t>().swap(apu_log_start_state);
+	std::vector<uint8_t>().swap(apu_log_end_state);
 }
 
 void SnsfOpt::DumpSPC(const std::string & filename)
 {
 	spc_dump_filename = filename;
 
-	if (!DelayedSPCDump) {
+	m_system->SetDSPCoverageOnly(false);
+
+	// capture points, in time order
+	spc_dump_times.clear();
+	if (DelayedSPCDump) {
+		spc_dump_times = spc_capture_times;
+		if (spc_dump_times.empty()) {
+			spc_dump_times.push_back(optimize_timeout);
+		}
+		std::sort(spc_dump_times.begin(), spc_dump_times.end());
+		spc_dump_count = spc_dump_times.size();
+	}
+	else if (!spc_capture_key_ons.empty()) {
+		m_system->DumpSPCSnapshots(spc_capture_key_ons);
+		spc_dump_count = spc_capture_key_ons.size();
+	}
+	else {
 		m_system->DumpSPCSnapshot();
+		spc_dump_count = 1;
 	}
 
 	Run(&SnsfOpt::SPCDump_Start, &SnsfOpt::SPCDump_BeforeLoop, &SnsfOpt::SPCDump_AfterLoop, &SnsfOpt::SPCDump_Finished, &SnsfOpt::SPCDump_End, &SnsfOpt::SPCDump_ShowProgress, &SnsfOpt::SPCDump_ShowResult);
@@ -697,13 +1487,18 @@ void SnsfOpt::ClearSPCTags(void)
 	spc_tags.clear();
 }
 
-void SnsfOpt::Optimize_Start(void)
+void SnsfOpt::ClearSPCSnapshots(void)
 {
-	if (spc_snapshot_dumped != NULL)
+	for (size_t i = 0; i < spc_snapshots_dumped.size(); i++)
 	{
-		delete spc_snapshot_dumped;
-		spc_snapshot_dumped = NULL;
+		delete spc_snapshots_dumped[i];
 	}
+	spc_snapshots_dumped.clear();
+}
+
+void SnsfOpt::Optimize_Start(void)
+{
+	ClearSPCSnapshots();
 
 	rom_bytes_used_old = m_system->GetROMCoverageSize();
 	apuram_bytes_used_old = m_system->GetAPURAMCoverageSize();
@@ -719,6 +1514,7 @@ void SnsfOpt::Optimize_Start(void)
 	oneshot_endpoint = 0.0;
 	oneshot = false;
 	initial_silence_length = 0.0;
+	voice_activity_end = 0.0;
 }
 
 void SnsfOpt::Optimize_BeforeLoop(void)
@@ -736,8 +1532,14 @@ void SnsfOpt::Optimize_AfterLoop(void)
 		time_last_new_data = m_output.get_timer();
 	}
 
-	// loop detection
-	DetectLoop();
+	// voices that are still sounding, or were keyed on during this frame
+	if (oneshot_guard_length > 0.0 && !m_system->CheckVoicesReleased())
+	{
+		voice_activity_end = m_output.get_timer();
+	}
+
+	// loop detection
+	DetectLoop();
 
 	// oneshot detection
 	DetectOneShot();
@@ -759,67 +1561,262 @@ bool SnsfOpt::Optimize_Finished(void)
 void SnsfOpt::Optimize_End(void)
 {
 	initial_silence_length = std::min(initial_silence_length, song_endpoint);
+
+	if (apu_log_replaying)
+	{
+		apu_log_replay_time = m_output.get_timer();
+	}
 }
 
 void SnsfOpt::Optimize_ShowProgress() const
 {
-	printf("%s: ", rom_filename.substr(0, 24).c_str());
-	printf("Time = %s", ToTimeString(song_endpoint).c_str());
+	Print("%s: ", rom_filename.substr(0, 24).c_str());
+	Print("Time = %s", ToTimeString(song_endpoint).c_str());
 
-	printf(", Remaining = %s", ToTimeString(std::max(0.0, optimize_endpoint - m_output.get_timer())).c_str());
+	Print(", Remaining = %s", ToTimeString(std::max(0.0, optimize_endpoint - m_output.get_timer())).c_str());
 	if (!time_loop_based)
 	{
-		printf(", %d bytes", m_system->GetROMCoverageSize());
+		Print(", %d bytes", m_system->GetROMCoverageSize());
 	}
 	else
 	{
-		printf(", Loop = %d", loop_count + 1);
+		Print(", Loop = %d", loop_count + 1);
 	}
 
 	fflush(stdout);
 
 	//       1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
-	printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-	printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-	printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
 }
 
 void SnsfOpt::Optimize_ShowResult() const
 {
-	printf("%s: ", rom_filename.c_str());
+	Print("%s: ", rom_filename.c_str());
 
 	if (!time_loop_based)
 	{
-		printf("Time = %s", ToTimeString(song_endpoint).c_str());
-		printf(", %d bytes", m_system->GetROMCoverageSize());
+		Print("Time = %s", ToTimeString(song_endpoint).c_str());
+		Print(", %d bytes", m_system->GetROMCoverageSize());
 	}
 	else
 	{
-		printf("Time = %s, Silence = %s",
+		Print("Time = %s, Silence = %s",
 			ToTimeString(song_endpoint - initial_silence_length).c_str(),
 			ToTimeString(initial_silence_length).c_str());
 
 		if (oneshot)
 		{
-			printf(" (One Shot)");
+			Print(" (One Shot)");
 		}
 		else
 		{
-			printf(" (%d Loops)", target_loop_count);
+			Print(" (%d Loops)", target_loop_count);
 		}
 	}
 
-	printf("                                            ");
-	printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-	printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-	printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-	printf("\n");
+	if (warm_boot_hit)
+	{
+		Print(" [Warm boot: %s skipped]", ToTimeString(warm_boot_time).c_str());
+	}
+
+	if (apu_log_replay_time > 0.0)
+	{
+		Print(" [APU log: %s replayed]", ToTimeString(apu_log_replay_time).c_str());
+	}
+
+	if (ShowIdleLoopStats)
+	{
+		Print(" [Idle loops: %llu cycles skipped]", (unsigned long long)m_system->GetIdleLoopSkippedCycles());
+	}
+
+	Print("                                            ");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\n");
+	fflush(stdout);
+}
+
+void SnsfOpt::snsf_sound_out::start_capture(std::vector<uint32_t> * checksums, uint32_t limit)
+{
+	block_checksums = checksums;
+	block_checksum = crc32(0L, Z_NULL, 0);
+	block_samples = 0;
+	capture_samples = 0;
+	capture_limit = limit;
+}
+
+void SnsfOpt::snsf_sound_out::capture(const int16_t * samples, unsigned long count)
+{
+	if (capture_limit != 0)
+	{
+		count = std::min<unsigned long>(count, capture_limit - capture_samples);
+	}
+	capture_samples += (uint32_t)count;
+
+	while (count > 0)
+	{
+		uint32_t len = (uint32_t)std::min<unsigned long>(count, capture_block_size - block_samples);
+		block_checksum = crc32(block_checksum, (const Bytef *)samples, len * sizeof(int16_t));
+		block_samples += len;
+		samples += len;
+		count -= len;
+
+		if (block_samples == capture_block_size)
+		{
+			block_checksums->push_back(block_checksum);
+			block_checksum = crc32(0L, Z_NULL, 0);
+			block_samples = 0;
+		}
+	}
+}
+
+void SnsfOpt::snsf_sound_out::flush_capture(void)
+{
+	if (block_checksums != NULL && block_samples != 0)
+	{
+		block_checksums->push_back(block_checksum);
+		block_checksum = crc32(0L, Z_NULL, 0);
+		block_samples = 0;
+	}
+}
+
+void SnsfOpt::CompareAudioOnly(void)
+{
+	bool audio_only = m_system->GetAudioOnly();
+
+	// both passes play the song from reset, with sound
+	warm_boot_pending = false;
+	m_system->SetDSPCoverageOnly(false);
+
+	for (compare_pass = 0; compare_pass < 2; compare_pass++)
+	{
+		if (compare_pass != 0)
+		{
+			ResetGame();
+		}
+
+		m_system->SetAudioOnly(compare_pass != 0);
+		Run(&SnsfOpt::Compare_Start, &SnsfOpt::Compare_BeforeLoop, &SnsfOpt::Compare_AfterLoop, &SnsfOpt::Compare_Finished, &SnsfOpt::Compare_End, &SnsfOpt::Compare_ShowProgress, &SnsfOpt::Compare_ShowResult);
+	}
+
+	m_system->SetAudioOnly(audio_only);
+	m_output.start_capture(NULL);
+	compare_checksums[0].clear();
+	compare_checksums[1].clear();
+}
+
+void SnsfOpt::Compare_Start()
+{
+	Optimize_Start();
+	compare_checksums[compare_pass].clear();
+	// the audio-only pass checks exactly the samples the normal one had
+	m_output.start_capture(&compare_checksums[compare_pass], (compare_pass != 0) ? compare_samples : 0);
+	compare_start_time = timer_get();
+}
+
+void SnsfOpt::Compare_BeforeLoop()
+{
+	Optimize_BeforeLoop();
+}
+
+void SnsfOpt::Compare_AfterLoop()
+{
+	Optimize_AfterLoop();
+}
+
+bool SnsfOpt::Compare_Finished(void)
+{
+	// the audio-only pass plays as long as the normal one did
+	if (compare_pass != 0)
+	{
+		return m_output.get_timer() >= compare_length;
+	}
+
+	return Optimize_Finished();
+}
+
+void SnsfOpt::Compare_End()
+{
+	Optimize_End();
+
+	compare_elapsed[compare_pass] = timer_get() - compare_start_time;
+	compare_rom_bytes[compare_pass] = m_system->GetROMCoverageSize();
+	m_output.flush_capture();
+	if (compare_pass == 0)
+	{
+		compare_length = m_output.get_timer();
+		compare_samples = m_output.capture_samples;
+	}
+	m_output.start_capture(NULL);
+}
+
+void SnsfOpt::Compare_ShowProgress() const
+{
+	Print("%s: ", rom_filename.substr(0, 24).c_str());
+	Print("%s, Time = %s", (compare_pass == 0) ? "Normal" : "Audio-only", ToTimeString(m_output.get_timer()).c_str());
+	Print(", Remaining = %s", ToTimeString(std::max(0.0, ((compare_pass == 0) ? optimize_endpoint : compare_length) - m_output.get_timer())).c_str());
+	Print(", %d bytes", m_system->GetROMCoverageSize());
+
+	fflush(stdout);
+
+	//       1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+}
+
+void SnsfOpt::Compare_ShowResult() const
+{
+	// reported once both passes are done
+	if (compare_pass == 0)
+	{
+		return;
+	}
+
+	Print("%s: ", rom_filename.c_str());
+	Print("Time = %s", ToTimeString(compare_length).c_str());
+	Print(", %u -> %u bytes", compare_rom_bytes[0], compare_rom_bytes[1]);
+	Print(", %.2f -> %.2f sec", compare_elapsed[0], compare_elapsed[1]);
+
+	// both passes checksummed the same samples, down to the last partial block
+	const std::vector<uint32_t> & normal = compare_checksums[0];
+	const std::vector<uint32_t> & audio_only = compare_checksums[1];
+	size_t block = 0;
+	while (block < normal.size() && block < audio_only.size() && normal[block] == audio_only[block])
+	{
+		block++;
+	}
+
+	if (block == normal.size())
+	{
+		Print(", same output");
+	}
+	else
+	{
+		double t = (double)block * snsf_sound_out::capture_block_size / 2 / m_output.sample_rate;
+		Print(", output differs from %s (not safe)", ToTimeString(t).c_str());
+	}
+
+	Print("                                            ");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\n");
 	fflush(stdout);
 }
 
 void SnsfOpt::SPCDump_Start()
 {
 	Optimize_Start();
+	spc_dump_captured = false;
+	spc_snapshot_time = 0.0;
+	spc_wiped_size = 0;
+	// only -w needs to see what the song touches
+	m_system->SetAPURAMAccessTracking(spc_wipe_length > 0.0);
 }
 
 void SnsfOpt::SPCDump_BeforeLoop()
@@ -835,29 +1832,62 @@ void SnsfOpt::SPCDump_AfterLoop()
 void SnsfOpt::SPCDump_End()
 {
 	Optimize_End();
+	m_system->SetAPURAMAccessTracking(false);
 }
 
 bool SnsfOpt::SPCDump_Finished(void)
 {
-	if (!DelayedSPCDump && m_system->HasSPCDumpFinished()) {
-		SPCFile * spc_file = m_system->PopSPCDump();
-		if (spc_file != NULL) {
-			spc_snapshot_dumped = spc_file;
+	double timer = m_output.get_timer();
+
+	if (!spc_dump_captured) {
+		// key-on triggered snapshots taken during this frame
+		SPCFile * spc_file;
+		while ((spc_file = m_system->PopSPCDump()) != NULL) {
+			spc_snapshots_dumped.push_back(spc_file);
+			spc_snapshot_time = timer;
 		}
 
-		return true;
-	}
+		if (DelayedSPCDump) {
+			size_t index = spc_dump_count - spc_dump_times.size();
+			while (!spc_dump_times.empty() && timer >= spc_dump_times.front()) {
+				spc_file = m_system->DumpSPCSnapshotImmediately();
+				if (spc_file != NULL) {
+					spc_snapshots_dumped.resize(index + 1, NULL);
+					spc_snapshots_dumped[index] = spc_file;
+					spc_snapshot_time = timer;
+				}
+				spc_dump_times.erase(spc_dump_times.begin());
+				index++;
+			}
 
-	if (DelayedSPCDump) {
-		if (m_output.get_timer() >= optimize_timeout) {
-			spc_snapshot_dumped = m_system->DumpSPCSnapshotImmediately();
+			spc_dump_captured = spc_dump_times.empty();
+		}
+		else {
+			spc_dump_captured = m_system->HasSPCDumpFinished();
+
+			// give up on key-ons that do not come
+			if (!spc_dump_captured && timer >= spc_snapshot_time + optimize_timeout) {
+				return true;
+			}
+		}
+
+		if (!spc_dump_captured) {
+			return false;
+		}
+
+		if (spc_wipe_length <= 0.0 || spc_snapshots_dumped.empty()) {
 			return true;
 		}
 	}
-	else {
-		if (m_output.get_timer() >= optimize_timeout) {
-			return true;
+
+	// wiping: keep running to see what the song uses after the snapshots
+	if (timer >= spc_snapshot_time + spc_wipe_length) {
+		for (size_t i = 0; i < spc_snapshots_dumped.size(); i++) {
+			if (spc_snapshots_dumped[i] != NULL) {
+				WipeUnusedAPURAM(*spc_snapshots_dumped[i]);
+			}
 		}
+		return true;
 	}
 
 	return false;
@@ -865,56 +1895,124 @@ bool SnsfOpt::SPCDump_Finished(void)
 
 void SnsfOpt::SPCDump_ShowProgress() const
 {
-	printf("%s: ", rom_filename.substr(0, 24).c_str());
-	printf("Time = %s", ToTimeString(m_output.get_timer()).c_str());
+	Print("%s: ", rom_filename.substr(0, 24).c_str());
+	Print("Time = %s", ToTimeString(m_output.get_timer()).c_str());
 	if (DelayedSPCDump) {
-		printf(", Remaining = %s", ToTimeString(std::max(0.0, optimize_endpoint - m_output.get_timer())).c_str());
+		Print(", Remaining = %s", ToTimeString(std::max(0.0, optimize_endpoint - m_output.get_timer())).c_str());
 	}
 
 	fflush(stdout);
 
 	//       1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
-	printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-	printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-	printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+}
+
+std::string SnsfOpt::GetSPCDumpPath(size_t index) const
+{
+	if (spc_dump_count <= 1)
+	{
+		return spc_dump_filename;
+	}
+
+	// numbered from 1 when there are several capture points
+	std::string path = spc_dump_filename;
+	std::string ext;
+	size_t ext_pos = path.find_last_of("./\\");
+	if (ext_pos != std::string::npos && path[ext_pos] == '.')
+	{
+		ext = path.substr(ext_pos);
+		path.erase(ext_pos);
+	}
+
+	char suffix[32];
+	sprintf(suffix, "_%u", (unsigned int)(index + 1));
+	return path + suffix + ext;
 }
 
 void SnsfOpt::SPCDump_ShowResult() const
 {
-	printf("%s: ", rom_filename.c_str());
+	Print("%s: ", rom_filename.c_str());
+
+	size_t spc_dumps_saved = 0;
+	for (size_t i = 0; i < spc_snapshots_dumped.size(); i++) {
+		SPCFile * spc_file = spc_snapshots_dumped[i];
+		if (spc_file == NULL) {
+			continue;
+		}
 
-	bool spc_dump_succeeded = false;
-	if (spc_snapshot_dumped != NULL) {
 		// remove emulator name if provided
-		spc_snapshot_dumped->tags.erase(SPCFile::XID6ItemId::XID6_DUMPER_NAME);
+		spc_file->tags.erase(SPCFile::XID6ItemId::XID6_DUMPER_NAME);
 
 		// set tags
-		spc_snapshot_dumped->ImportPSFTag(spc_tags);
+		spc_file->ImportPSFTag(spc_tags);
 
 		// write to disk
-		spc_dump_succeeded = spc_snapshot_dumped->Save(spc_dump_filename);
+		if (spc_file->Save(GetSPCDumpPath(i))) {
+			spc_dumps_saved++;
+		}
 	}
 
-	if (spc_dump_succeeded) {
-		if (DelayedSPCDump) {
-			printf("Dumped spc snapshot");
+	if (spc_dumps_saved != 0) {
+		if (spc_dump_count > 1) {
+			Print("Dumped %u of %u %sspc snapshots", (unsigned int)spc_dumps_saved, (unsigned int)spc_dump_count, DelayedSPCDump ? "" : "key-on triggered ");
+		}
+		else if (DelayedSPCDump) {
+			Print("Dumped spc snapshot");
 		}
 		else {
-			printf("Dumped key-on triggered spc snapshot");
+			Print("Dumped key-on triggered spc snapshot");
+		}
+
+		if (spc_wipe_length > 0.0) {
+			Print(" (%u bytes wiped)", spc_wiped_size);
 		}
 	}
 	else {
-		printf("Failed to make spc snapshot");
+		Print("Failed to make spc snapshot");
 	}
 
-	printf("                                            ");
-	printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-	printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-	printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
-	printf("\n");
+	Print("                                            ");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b");
+	Print("\n");
 	fflush(stdout);
 }
 
+void SnsfOpt::WipeUnusedAPURAM(SPCFile & spc)
+{
+	const uint8_t * access = m_system->GetAPURAMAccess();
+
+	std::vector<uint8_t> keep(access, access + SNES_APU_RAM_SIZE);
+
+	// direct page and stack are kept as a whole, as they can be reached
+	// through pointers and stack frames the SPC700 did not use yet
+	memset(&keep[0x0000], 1, 0x200);
+
+	// the echo buffer set up in the snapshot, which wraps around like the
+	// DSP's echo pointer
+	uint32_t echo_start = spc.dsp[0x6d] * 0x100;
+	uint32_t echo_size = std::max(4, (spc.dsp[0x7d] & 0x0f) * 0x800);
+	for (uint32_t offset = 0; offset < echo_size; offset++)
+	{
+		keep[(echo_start + offset) & (SNES_APU_RAM_SIZE - 1)] = 1;
+	}
+
+	// the RAM under the IPL ROM
+	memset(&keep[0xffc0], 1, 0x40);
+
+	for (uint32_t addr = 0; addr < SNES_APU_RAM_SIZE; addr++)
+	{
+		if (!keep[addr])
+		{
+			spc.ram[addr] = 0;
+			spc_wiped_size++;
+		}
+	}
+}
+
 uint8_t SnsfOpt::ExpectPossibleLoopCount(const uint32_t * histogram, const uint32_t * new_histogram) const
 {
 	// detect possible maximum value of loop count at the moment
@@ -935,7 +2033,20 @@ uint8_t SnsfOpt::ExpectPossibleLoopCount(const uint32_t * histogram, const uint3
 void SnsfOpt::DetectLoop()
 {
 	// detect possible maximum value of loop count at the moment
-	uint8_t loop_count_expected_upper = ExpectPossibleLoopCount(rom_refs_histogram, m_system->GetROMCoverageHistogram());
+	uint8_t loop_count_expected_upper;
+	if (apu_log_replaying)
+	{
+		// the 65c816 is not emulated, its part was logged instead
+		loop_count_expected_upper = apu_log_rom_loops[apu_log_frame - 1];
+	}
+	else
+	{
+		loop_count_expected_upper = ExpectPossibleLoopCount(rom_refs_histogram, m_system->GetROMCoverageHistogram());
+		if (apu_log_recording)
+		{
+			apu_log_rom_loops.push_back(loop_count_expected_upper);
+		}
+	}
 
 	// check APU RAM as well, if timer is required
 	if (time_loop_based) {
@@ -1007,7 +2118,15 @@ void SnsfOpt::DetectLoop()
 
 void SnsfOpt::DetectOneShot()
 {
-	if (m_output.get_silence_length() >= oneshot_verify_length && loop_count != 0) {
+	double silence_length = m_output.get_silence_length();
+	bool silent = (silence_length >= oneshot_verify_length);
+	if (!silent && oneshot_guard_length > 0.0)
+	{
+		// no voice can sound again without a key-on, so a short guard is enough
+		silent = (silence_length >= oneshot_guard_length && m_output.get_timer() - voice_activity_end >= oneshot_guard_length);
+	}
+
+	if (silent && loop_count != 0) {
 		oneshot_endpoint = m_output.get_silence_start();
 		oneshot = true;
 	}
@@ -1064,6 +2183,16 @@ uint32_t SnsfOpt::MergeRefs(uint8_t * dst_refs, const uint8_t * src_refs, uint32
 	return bytes_used;
 }
 
+void SnsfOpt::MergeCoverage(const SnsfOpt & src)
+{
+	MergeRefs(rom_refs, src.rom_refs, SNES_HEADER_SIZE + MAX_SNES_ROM_SIZE);
+
+	if (src.m_system->IsLoaded())
+	{
+		MergeRefs(rom_refs, src.m_system->GetROMCoverage(), src.GetROMSize());
+	}
+}
+
 bool SnsfOpt::GetROM(void * rom, uint32_t size, bool wipe_unused_data)
 {
 	uint32_t rom_size = GetROMSize();
@@ -1238,6 +2367,7 @@ enum SnsfOptProcMode
 	SNSFOPT_PROC_X,
 	SNSFOPT_PROC_S,
 	SNSFOPT_PROC_T,
+	SNSFOPT_PROC_A,
 };
 
 static void usage(const char * progname, bool extended)
@@ -1248,7 +2378,7 @@ static void usage(const char * progname, bool extended)
 	printf("Usage\n");
 	printf("-----\n");
 	printf("\n");
-	printf("Syntax: `%s [options] [-s or -l or -f or -r or -x or -t] [snsf files]`\n", progname);
+	printf("Syntax: `%s [options] [-s or -l or -f or -r or -x or -t or -a] [snsf files]`\n", progname);
 	printf("\n");
 
 	if (!extended)
@@ -1275,11 +2405,41 @@ static void usage(const char * progname, bool extended)
 		printf("`-cs`\n");
 		printf("  : Correct header checksum before writing a ROM/SNSF.\n");
 		printf("\n");
+		printf("`-j [count]`\n");
+		printf("  : Process up to [count] files (or song values of -s) in parallel\n");
+		printf("    with -f, -l, -s, -r, -x, -t and -a. 0 means the number of CPU threads.\n");
+		printf("    Output is shown per file, in order.\n");
+		printf("\n");
+		printf("`--cache [directory]`\n");
+		printf("  : Keep the emulator state after the warm-up of each song in [directory],\n");
+		printf("    and start from there when the same song is processed again\n");
+		printf("    with -f, -l and -t. Reused states are reported per file.\n");
+		printf("\n");
+		printf("`--warmup [time]` (default=0:02.000)\n");
+		printf("  : Length of the warm-up kept by `--cache`.\n");
+		printf("\n");
+		printf("`--apu-log [directory]`\n");
+		printf("  : Keep a log of what the main CPU does to the sound CPU during each\n");
+		printf("    song timed with -t in [directory]. Timing the same song again replays\n");
+		printf("    the log on the sound CPU alone, whatever the -t options are, and only\n");
+		printf("    emulates the whole system past its end. Takes the place of `--cache`\n");
+		printf("    for -t.\n");
+		printf("\n");
+		printf("`--idle-stats`\n");
+		printf("  : Show how many master cycles the main CPU spent in idle loops\n");
+		printf("    that were skipped instead of being interpreted.\n");
+		printf("\n");
+		printf("`--audio-only`\n");
+		printf("  : DMA and HDMA from memory to $2104, $2118, $2119 and $2122 (OAM,\n");
+		printf("    VRAM and CGRAM data) only take their time, so graphics uploads\n");
+		printf("    are neither emulated nor kept in the optimized ROM.\n");
+		printf("    Check that a game is safe for it with -a first.\n");
+		printf("\n");
 		printf("`--offset [load offset]`\n");
 		printf("  : Load offset of the base snsflib file.\n");
 		printf("    (The option works only if the input is SNES ROM file)\n");
 		printf("\n");
-		printf("#### File Processing Modes (-s) (-l) (-f) (-r) (-x) (-t)\n");
+		printf("#### File Processing Modes (-s) (-l) (-f) (-r) (-x) (-t) (-a)\n");
 		printf("\n");
 		printf("`-f [snsf files]`\n");
 		printf("  : Optimize single files, and in the process, convert\n");
@@ -1302,6 +2462,14 @@ static void usage(const char * progname, bool extended)
 		printf("    Unlike psf playback, silence detection is MANDATORY\n");
 		printf("    Do NOT try to evade this with an excessively long silence detect time.\n");
 		printf("    (The max time is less than 2*Verify loops for silence detection)\n");
+		printf("    SPC files are timed too, running the sound CPU alone,\n");
+		printf("    and `-T` writes their ID666/xid6 length and fade.\n");
+		printf("\n");
+		printf("`-a [snsf files]`\n");
+		printf("  : Compare `--audio-only` with the normal emulation. Plays each song\n");
+		printf("    normally until no new data has been found for `-T` [time], then\n");
+		printf("    as long again audio-only, and reports the ROM bytes used, the run\n");
+		printf("    time and where the output first differs, if it does.\n");
 		printf("\n");
 		printf("#### Options for -t\n");
 		printf("\n");
@@ -1325,118 +2493,787 @@ static void usage(const char * progname, bool extended)
 		printf("  : Time in seconds for silence detection (default 15 seconds)\n");
 		printf("    Max (2*Verify loop count) seconds.\n");
 		printf("\n");
+		printf("`-g [time]`\n");
+		printf("  : Also end a one shot song once every voice has released and nothing\n");
+		printf("    was keyed on for [time], with the output silent as long. Songs that\n");
+		printf("    keep a voice keyed on still wait for `-s`. (default off)\n");
+		printf("\n");
 		printf("#### Options for -x\n");
 		printf("\n");
 		printf("`-d`\n");
 		printf("  : Delayed SPC capture, delay-time can be specified by `-T [time] -x -d`\n");
 		printf("\n");
+		printf("`-T [time]`\n");
+		printf("  : Delayed SPC capture at [time]. Repeat it to capture several snapshots\n");
+		printf("    from a single run, written as name_1.spc, name_2.spc and so on.\n");
+		printf("\n");
+		printf("`-k [list]`\n");
+		printf("  : Capture a snapshot at each key-on in [list], such as `1,3,5-8`,\n");
+		printf("    instead of the first key-on only. Several snapshots are numbered\n");
+		printf("    like `-T`. Cannot be used with `-d` or `-T`.\n");
+		printf("\n");
+		printf("`-w [time]`\n");
+		printf("  : Keep playing for [time] after the capture, then zero the APU RAM\n");
+		printf("    that was not used meanwhile, so the SPC compresses better.\n");
+		printf("    The direct page, the stack and the echo buffer are always kept.\n");
+		printf("    (default off)\n");
+		printf("\n");
 	}
 }
 
-int main(int argc, char *argv[])
+// Parameters of a batch mode (-f, -r, -x or -t) that are not kept by SnsfOpt
+struct SnsfOptBatch
 {
-	SnsfOpt opt;
-	SnsfOptProcMode mode = SNSFOPT_PROC_NONE;
-
+	SnsfOptProcMode mode;
 	std::string out_name;
+	const char * psfby;
+	bool add_snsf_tags;
+	double loop_fade_length;
+	double oneshot_postgap_length;
+};
 
-	double loopFadeLength = 10.0;
-	double oneshotPostgapLength = 1.0;
-	bool addSNSFTags = false;
-
-	char *psfby = NULL;
-
-	long l;
-	unsigned long ul;
-	char * endptr = NULL;
-
-	if (argc >= 2 && (strcmp(argv[1], "-?") == 0 || strcmp(argv[1], "--help") == 0))
-	{
-		usage(argv[0], true);
-		return -1;
-	}
-	else if (argc == 1)
-	{
-		usage(argv[0], false);
-		return -1;
-	}
+// Parses a list of key-on indices such as "1,3,5-8" (sorted, duplicates removed)
+static bool ParseKeyOnList(const char * str, std::vector<int> & key_ons)
+{
+	key_ons.clear();
 
-	int argi;
-	for(argi = 1; argi < argc; argi++)
+	const char * p = str;
+	while (true)
 	{
-		if (argv[argi][0] != '-')
+		char * endptr;
+		errno = 0;
+		long first = strtol(p, &endptr, 10);
+		if (endptr == p || errno == ERANGE || first < 1 || first > INT_MAX)
 		{
-			break;
+			return false;
 		}
 
-		if (strcmp(argv[argi], "-f") == 0)  //regular .snsf optimization. this option doubles as minisnsf->snsf converter
+		long last = first;
+		p = endptr;
+		if (*p == '-')
 		{
-			mode = SNSFOPT_PROC_F;
-
-			if (argc <= (argi + 1))
+			p++;
+			last = strtol(p, &endptr, 10);
+			if (endptr == p || errno == ERANGE || last < first || last > INT_MAX)
 			{
-				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
-				return 1;
+				return false;
 			}
-			argi++;
+			p = endptr;
 		}
-		else if (strcmp(argv[argi], "-r") == 0)
-		{
-			mode = SNSFOPT_PROC_R;
 
-			if (argc <= (argi + 1))
-			{
-				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
-				return 1;
-			}
-			argi++;
+		if (last - first >= 0x10000)
+		{
+			return false;
 		}
-		else if (strcmp(argv[argi], "-x") == 0)
+
+		for (long i = first; i <= last; i++)
 		{
-			mode = SNSFOPT_PROC_X;
+			key_ons.push_back((int)i);
+		}
 
-			if (argc <= (argi + 1))
-			{
-				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
-				return 1;
-			}
-			argi++;
+		if (*p == '\0')
+		{
+			break;
 		}
-		else if (strcmp(argv[argi], "-s") == 0)  //Song value snsflib optimization.
+		if (*p != ',')
 		{
-			mode = SNSFOPT_PROC_S;
+			return false;
+		}
+		p++;
+	}
 
-			if (argc <= (argi + 3))
-			{
-				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
-				return 1;
-			}
+	std::sort(key_ons.begin(), key_ons.end());
+	key_ons.erase(std::unique(key_ons.begin(), key_ons.end()), key_ons.end());
+	return true;
+}
+
+static std::string GetOutputPath(const char * path, const std::string & out_name, const char * default_ext)
+{
+	std::string out_path;
+	if (out_name.empty())
+	{
+		const char *ext = path_findext(path);
+		if (*ext == '\0')
+		{
+			out_path = path;
+			out_path += default_ext;
+		}
+		else
+		{
+			out_path = std::string(path, ext - path);
+			out_path += default_ext;
+		}
+	}
+	else
+	{
+		out_path = out_name;
+
+		const char *ext = path_findext(out_name.c_str());
+		if (*ext == '\0')
+		{
+			out_path += default_ext;
+		}
+	}
+	return out_path;
+}
+
+static bool ProcessBatchFile(SnsfOpt & opt, const SnsfOptBatch & batch, const char * path)
+{
+	switch (batch.mode)
+	{
+		case SNSFOPT_PROC_F:
+		{
+			// determine output filename
+			std::string out_path = GetOutputPath(path, batch.out_name, ".snsf");
+
+			opt.Print("Optimizing %s\n", path);
+
+			opt.ResetOptimizer();
+			if (!opt.LoadROMFile(path))
+			{
+				opt.PrintError("Error: %s\n", opt.message().c_str());
+				return false;
+			}
+			opt.Optimize();
+
+			std::map<std::string, std::string> tags;
+			if (batch.psfby != NULL && strcmp(batch.psfby, "") != 0) {
+				tags["snsfby"] = batch.psfby;
+			}
+
+			opt.SaveSNSF(out_path, 0, true, tags);
+
+			if (opt.GetParanoidClosedAreaFillSize() > 0) {
+				opt.Print("Preserved any data within %d bytes between two used bytes.\n",
+					opt.GetParanoidClosedAreaFillSize());
+			}
+
+			if (opt.GetParanoidPostFillSize() > 0) {
+				opt.Print("Preserved any data within %d trailing bytes of a used byte.\n",
+					opt.GetParanoidPostFillSize());
+			}
+
+			opt.Print("Covered %u bytes. Preserved %d extra bytes.\n", opt.GetCoveredSize(), opt.GetParanoidFilledSize());
+			break;
+		}
+
+		case SNSFOPT_PROC_R:
+		{
+			std::string out_path = GetOutputPath(path, batch.out_name, ".smc");
+
+			if (!opt.LoadROMFile(path))
+			{
+				opt.PrintError("Error: %s\n", opt.message().c_str());
+				return false;
+			}
+			opt.SaveROM(out_path, false);
+			break;
+		}
+
+		case SNSFOPT_PROC_X:
+		{
+			std::string out_path = GetOutputPath(path, batch.out_name, ".spc");
+
+			opt.ResetOptimizer(false);
+			if (!opt.LoadROMFile(path))
+			{
+				opt.PrintError("Error: %s\n", opt.message().c_str());
+				return false;
+			}
+
+			opt.ClearSPCTags();
+			if (PSFFile::IsPSFFile(path)) {
+				PSFFile * psf_file = PSFFile::load(path);
+				if (psf_file != NULL) {
+					opt.SetSPCTags(psf_file->tags);
+					delete psf_file;
+				}
+			}
+
+			opt.DumpSPC(out_path);
+			break;
+		}
+
+		case SNSFOPT_PROC_A:
+		{
+			opt.ResetOptimizer();
+			if (!opt.LoadROMFile(path))
+			{
+				opt.PrintError("Error: %s\n", opt.message().c_str());
+				return false;
+			}
+			opt.CompareAudioOnly();
+			break;
+		}
+
+		case SNSFOPT_PROC_T:
+		{
+			// determine output filename
+			std::string out_path = path;
+
+			// an SPC file is timed on the APU alone
+			bool spc_input = SPCFile::IsSPCFile(path);
+
+			opt.ResetOptimizer();
+			if (!(spc_input ? opt.LoadSPCFile(path) : opt.LoadROMFile(path)))
+			{
+				opt.PrintError("Error: %s\n", opt.message().c_str());
+				return false;
+			}
+			opt.Optimize();
+
+#ifdef _DEBUG
+			//for (int count = 1; count <= opt.GetTargetLoopCount(); count++)
+			//{
+			//	printf("Loop Point %d = %s\n", count, opt.GetLoopPointString(count).c_str());
+			//}
+#endif
+
+			if (batch.add_snsf_tags)
+			{
+				std::map<std::string, std::string> tags;
+				if (opt.IsOneShot())
+				{
+					if (opt.GetOneShotEndPoint() == opt.GetInitialSilenceLength())
+					{
+						tags["length"] = "0";
+					}
+					else
+					{
+						tags["length"] = SnsfOpt::ToTimeString(opt.GetOneShotEndPoint() + batch.oneshot_postgap_length - opt.GetInitialSilenceLength(), false);
+					}
+					tags["fade"] = "0";
+				}
+				else
+				{
+					tags["length"] = SnsfOpt::ToTimeString(opt.GetLoopPoint() - opt.GetInitialSilenceLength(), false);
+
+					if (batch.loop_fade_length >= 0.001)
+					{
+						tags["fade"] = SnsfOpt::ToTimeString(batch.loop_fade_length, false);
+					}
+					else
+					{
+						tags["fade"] = "0";
+					}
+				}
+
+				if (spc_input)
+				{
+					// written as ID666/xid6 length and fade
+					SPCFile * spc = SPCFile::Load(path);
+					if (spc == NULL)
+					{
+						opt.PrintError("Error: Invalid SPC file %s (file operation error)\n", path);
+						return false;
+					}
+
+					spc->ImportPSFTag(tags);
+
+					if (!spc->Save(out_path)) {
+						opt.PrintError("Error: Unable to save SPC file %s\n", path);
+						delete spc;
+						return false;
+					}
+
+					delete spc;
+				}
+				else
+				{
+					PSFFile * snsf = PSFFile::load(path);
+					if (snsf == NULL)
+					{
+						opt.PrintError("Error: Invalid PSF file %s (file operation error)\n", path);
+						return false;
+					}
+
+					snsf->tags["length"] = tags["length"];
+					snsf->tags["fade"] = tags["fade"];
+
+					if (!snsf->save(out_path)) {
+						opt.PrintError("Error: Unable to save PSF file %s\n", path);
+						delete snsf;
+						return false;
+					}
+
+					delete snsf;
+				}
+			}
+			break;
+		}
+
+		default:
+			return false;
+	}
+
+	return true;
+}
+
+// Work split over several threads by RunParallel(). Each worker thread owns a
+// SnsfOpt with the settings of the main one; tasks are handed out in index order.
+class SnsfOptParallelJob
+{
+public:
+	virtual ~SnsfOptParallelJob()
+	{
+	}
+
+	// Called on each worker before its first task, with the console output of that task
+	virtual bool Prepare(SnsfOpt & /*opt*/)
+	{
+		return true;
+	}
+
+	virtual bool Process(SnsfOpt & opt, int index) = 0;
+
+	// Called on the main thread for each worker once all tasks have succeeded
+	virtual void Finish(SnsfOpt & /*opt*/)
+	{
+	}
+};
+
+struct SnsfOptParallelState
+{
+	SnsfOptParallelJob * job;
+	int task_count;
+
+	struct result
+	{
+		bool done;
+		bool succeeded;
+		std::string out;
+		std::string err;
+	};
+	std::vector<result> results;
+
+	std::mutex mutex;
+	std::condition_variable task_done;
+	int next_task;
+	int first_failure;
+};
+
+static void ParallelWorker(SnsfOptParallelState * state, SnsfOpt * opt)
+{
+	bool prepared = false;
+	bool prepare_succeeded = false;
+
+	while (true)
+	{
+		int index;
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			if (state->next_task >= state->task_count || state->next_task > state->first_failure)
+			{
+				break;
+			}
+			index = state->next_task++;
+		}
+
+		std::string out;
+		std::string err;
+		opt->SetConsoleBuffer(&out, &err);
+		if (!prepared)
+		{
+			prepare_succeeded = state->job->Prepare(*opt);
+			prepared = true;
+		}
+		bool succeeded = prepare_succeeded && state->job->Process(*opt, index);
+		opt->SetConsoleBuffer(NULL, NULL);
+
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			SnsfOptParallelState::result & result = state->results[index];
+			result.out.swap(out);
+			result.err.swap(err);
+			result.succeeded = succeeded;
+			result.done = true;
+			if (!succeeded && index < state->first_failure)
+			{
+				state->first_failure = index;
+			}
+		}
+		state->task_done.notify_all();
+	}
+}
+
+// Runs the tasks of a job on several threads. Console output of each task is
+// written in index order once the task is done, and processing stops at the
+// first failed task, as a sequential loop does.
+static int RunParallel(const SnsfOpt & base_opt, SnsfOptParallelJob & job, int task_count, unsigned int jobs)
+{
+	SnsfOptParallelState state;
+	state.job = &job;
+	state.task_count = task_count;
+	state.results.resize(task_count);
+	for (int i = 0; i < task_count; i++)
+	{
+		state.results[i].done = false;
+		state.results[i].succeeded = false;
+	}
+	state.next_task = 0;
+	state.first_failure = task_count;
+
+	if (jobs > (unsigned int)task_count)
+	{
+		jobs = (unsigned int)task_count;
+	}
+
+	std::vector<SnsfOpt *> opts;
+	std::vector<std::thread> workers;
+	for (unsigned int i = 0; i < jobs; i++)
+	{
+		SnsfOpt * opt = new SnsfOpt;
+		opt->CopySettings(base_opt);
+		opts.push_back(opt);
+		workers.push_back(std::thread(ParallelWorker, &state, opt));
+	}
+
+	int exit_code = 0;
+	for (int i = 0; i < task_count; i++)
+	{
+		std::string out;
+		std::string err;
+		bool succeeded;
+		{
+			std::unique_lock<std::mutex> lock(state.mutex);
+			while (!state.results[i].done)
+			{
+				state.task_done.wait(lock);
+			}
+			out.swap(state.results[i].out);
+			err.swap(state.results[i].err);
+			succeeded = state.results[i].succeeded;
+		}
+
+		fwrite(out.data(), 1, out.size(), stdout);
+		fflush(stdout);
+		fwrite(err.data(), 1, err.size(), stderr);
+		fflush(stderr);
+
+		if (!succeeded)
+		{
+			exit_code = 1;
+			break;
+		}
+	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	for (size_t i = 0; i < opts.size(); i++)
+	{
+		if (exit_code == 0)
+		{
+			job.Finish(*opts[i]);
+		}
+		delete opts[i];
+	}
+
+	return exit_code;
+}
+
+class SnsfOptBatchJob : public SnsfOptParallelJob
+{
+public:
+	SnsfOptBatchJob(const SnsfOptBatch & batch, char * const * files) :
+		m_batch(batch),
+		m_files(files)
+	{
+	}
+
+	virtual bool Process(SnsfOpt & opt, int index)
+	{
+		return ProcessBatchFile(opt, m_batch, m_files[index]);
+	}
+
+private:
+	const SnsfOptBatch & m_batch;
+	char * const * m_files;
+};
+
+static void PatchSongValue(SnsfOpt & opt, uint32_t offset, uint32_t size, uint32_t song)
+{
+	uint8_t patch[4] = {
+		static_cast<uint8_t>(song & 0xff),
+		static_cast<uint8_t>((song >> 8) & 0xff),
+		static_cast<uint8_t>((song >> 16) & 0xff),
+		static_cast<uint8_t>((song >> 24) & 0xff),
+	};
+	opt.PatchROM(offset, patch, size, true);
+}
+
+// Optimizes a snsflib for one song value (-s)
+static void OptimizeSongValue(SnsfOpt & opt, const char * path, uint32_t offset, uint32_t size, uint32_t song)
+{
+	opt.Print("Optimizing %s  Song value %X\n", path, song);
+
+	PatchSongValue(opt, offset, size, song);
+
+	// every song value boots the same way until it reads the patched bytes
+	opt.ResumeGame();
+
+	opt.Optimize();
+}
+
+// Song value sweep of -s. Every worker loads the snsflib once and collects the
+// coverage of its song values; the coverage is merged into the main optimizer.
+class SnsfOptSweepJob : public SnsfOptParallelJob
+{
+public:
+	SnsfOptSweepJob(SnsfOpt & reducer, const char * path, uint32_t offset, uint32_t size) :
+		m_reducer(reducer),
+		m_path(path),
+		m_offset(offset),
+		m_size(size)
+	{
+	}
+
+	virtual bool Prepare(SnsfOpt & opt)
+	{
+		opt.ResetOptimizer();
+		if (!opt.LoadROMFile(m_path))
+		{
+			opt.PrintError("Error: %s\n", opt.message().c_str());
+			return false;
+		}
+		opt.SetCheckpointTrigger(m_offset, m_size, true);
+		return true;
+	}
+
+	virtual bool Process(SnsfOpt & opt, int index)
+	{
+		OptimizeSongValue(opt, m_path, m_offset, m_size, (uint32_t)index);
+		return true;
+	}
+
+	virtual void Finish(SnsfOpt & opt)
+	{
+		m_reducer.MergeCoverage(opt);
+	}
+
+private:
+	SnsfOpt & m_reducer;
+	const char * m_path;
+	uint32_t m_offset;
+	uint32_t m_size;
+};
+
+// snsflib optimization of -l. Every worker optimizes some of the minisnsfs;
+// the coverage is merged into the main optimizer.
+class SnsfOptLibraryJob : public SnsfOptParallelJob
+{
+public:
+	SnsfOptLibraryJob(SnsfOpt & reducer, char * const * files) :
+		m_reducer(reducer),
+		m_files(files)
+	{
+	}
+
+	virtual bool Prepare(SnsfOpt & opt)
+	{
+		opt.ResetOptimizer();
+		return true;
+	}
+
+	virtual bool Process(SnsfOpt & opt, int index)
+	{
+		opt.Print("Optimizing %s\n", m_files[index]);
+
+		if (!opt.LoadROMFile(m_files[index]))
+		{
+			opt.PrintError("Error: %s\n", opt.message().c_str());
+			return false;
+		}
+		opt.Optimize();
+		return true;
+	}
+
+	virtual void Finish(SnsfOpt & opt)
+	{
+		m_reducer.MergeCoverage(opt);
+	}
+
+private:
+	SnsfOpt & m_reducer;
+	char * const * m_files;
+};
+
+int main(int argc, char *argv[])
+{
+	SnsfOpt opt;
+	SnsfOptProcMode mode = SNSFOPT_PROC_NONE;
+
+	std::string out_name;
+
+	double loopFadeLength = 10.0;
+	double oneshotPostgapLength = 1.0;
+	bool addSNSFTags = false;
+	unsigned int jobs = 1;
+	std::string warmBootDir;
+	double warmBootLength = 2.0;
+
+	char *psfby = NULL;
+
+	long l;
+	unsigned long ul;
+	char * endptr = NULL;
+
+	if (argc >= 2 && (strcmp(argv[1], "-?") == 0 || strcmp(argv[1], "--help") == 0))
+	{
+		usage(argv[0], true);
+		return -1;
+	}
+	else if (argc == 1)
+	{
+		usage(argv[0], false);
+		return -1;
+	}
+
+	int argi;
+	for(argi = 1; argi < argc; argi++)
+	{
+		if (argv[argi][0] != '-')
+		{
+			break;
+		}
+
+		if (strcmp(argv[argi], "-f") == 0)  //regular .snsf optimization. this option doubles as minisnsf->snsf converter
+		{
+			mode = SNSFOPT_PROC_F;
+
+			if (argc <= (argi + 1))
+			{
+				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+				return 1;
+			}
+			argi++;
+		}
+		else if (strcmp(argv[argi], "-r") == 0)
+		{
+			mode = SNSFOPT_PROC_R;
+
+			if (argc <= (argi + 1))
+			{
+				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+				return 1;
+			}
+			argi++;
+		}
+		else if (strcmp(argv[argi], "-x") == 0)
+		{
+			mode = SNSFOPT_PROC_X;
+
+			if (argc <= (argi + 1))
+			{
+				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+				return 1;
+			}
+			argi++;
+		}
+		else if (strcmp(argv[argi], "-s") == 0)  //Song value snsflib optimization.
+		{
+			mode = SNSFOPT_PROC_S;
+
+			if (argc <= (argi + 3))
+			{
+				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+				return 1;
+			}
+			argi++;
+		}
+		else if (strcmp(argv[argi], "-l") == 0)  //snsflib optimization.
+		{
+			mode = SNSFOPT_PROC_L;
+
+			if (argc <= (argi + 1))
+			{
+				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+				return 1;
+			}
+			argi++;
+		}
+		else if (strcmp(argv[argi], "-t") == 0)
+		{
+			mode = SNSFOPT_PROC_T;
+			opt.SetTimeLoopBased(true);
+
+			if (argc <= (argi + 1))
+			{
+				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+				return 1;
+			}
+			argi++;
+		}
+		else if (strcmp(argv[argi], "-a") == 0)
+		{
+			mode = SNSFOPT_PROC_A;
+
+			if (argc <= (argi + 1))
+			{
+				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+				return 1;
+			}
+			argi++;
+		}
+		else if (strcmp(argv[argi], "-T") == 0) // Optimize while no new data found for.
+		{
+			if (argc <= (argi + 1))
+			{
+				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+				return 1;
+			}
+
+			opt.SetTimeout(SnsfOpt::ToTimeValue(argv[argi + 1]));
+			argi++;
+		}
+		else if (strcmp(argv[argi], "-p") == 0) // I am paranoid. assume within x bytes between two used bytes is also used.
+		{
+			if (argc <= (argi + 1))
+			{
+				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+				return 1;
+			}
+
+			l = strtol(argv[argi + 1], &endptr, 0);
+			if (*endptr != '\0' || errno == ERANGE || l < 0)
+			{
+				fprintf(stderr, "Error: Number format error \"%s\"\n", argv[argi + 1]);
+				return 1;
+			}
+			opt.SetParanoidClosedAreaFillSize(l);
 			argi++;
 		}
-		else if (strcmp(argv[argi], "-l") == 0)  //snsflib optimization.
+		else if (strcmp(argv[argi], "-P") == 0) // I am paranoid. assume within x trailing bytes of a used byte is also used.
 		{
-			mode = SNSFOPT_PROC_L;
-
 			if (argc <= (argi + 1))
 			{
 				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
 				return 1;
 			}
+
+			l = strtol(argv[argi + 1], &endptr, 0);
+			if (*endptr != '\0' || errno == ERANGE || l < 0)
+			{
+				fprintf(stderr, "Error: Number format error \"%s\"\n", argv[argi + 1]);
+				return 1;
+			}
+			opt.SetParanoidPostFillSize(l);
 			argi++;
 		}
-		else if (strcmp(argv[argi], "-t") == 0)
+		else if (strcmp(argv[argi], "-o") == 0)
 		{
-			mode = SNSFOPT_PROC_T;
-			opt.SetTimeLoopBased(true);
-
 			if (argc <= (argi + 1))
 			{
 				fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
 				return 1;
 			}
+
+			out_name = argv[argi + 1];
 			argi++;
 		}
-		else if (strcmp(argv[argi], "-T") == 0) // Optimize while no new data found for.
+		else if (strcmp(argv[argi], "--psfby") == 0 || strcmp(argv[argi], "--snsfby") == 0)
 		{
 			if (argc <= (argi + 1))
 			{
@@ -1444,10 +3281,10 @@ int main(int argc, char *argv[])
 				return 1;
 			}
 
-			opt.SetTimeout(SnsfOpt::ToTimeValue(argv[argi + 1]));
+			psfby = argv[argi + 1];
 			argi++;
 		}
-		else if (strcmp(argv[argi], "-p") == 0) // I am paranoid. assume within x bytes between two used bytes is also used.
+		else if (strcmp(argv[argi], "--offset") == 0)
 		{
 			if (argc <= (argi + 1))
 			{
@@ -1461,10 +3298,14 @@ int main(int argc, char *argv[])
 				fprintf(stderr, "Error: Number format error \"%s\"\n", argv[argi + 1]);
 				return 1;
 			}
-			opt.SetParanoidClosedAreaFillSize(l);
+			opt.SetSNSFBaseOffset((uint32_t)l);
 			argi++;
 		}
-		else if (strcmp(argv[argi], "-P") == 0) // I am paranoid. assume within x trailing bytes of a used byte is also used.
+		else if (strcmp(argv[argi], "-cs") == 0 || strcmp(argv[argi], "--fix-checksum") == 0)
+		{
+			opt.FixROMChecksum = true;
+		}
+		else if (strcmp(argv[argi], "-j") == 0 || strcmp(argv[argi], "--jobs") == 0)
 		{
 			if (argc <= (argi + 1))
 			{
@@ -1478,10 +3319,15 @@ int main(int argc, char *argv[])
 				fprintf(stderr, "Error: Number format error \"%s\"\n", argv[argi + 1]);
 				return 1;
 			}
-			opt.SetParanoidPostFillSize(l);
+
+			jobs = (unsigned int)l;
+			if (jobs == 0)
+			{
+				jobs = std::max(1u, std::thread::hardware_concurrency());
+			}
 			argi++;
 		}
-		else if (strcmp(argv[argi], "-o") == 0)
+		else if (strcmp(argv[argi], "--cache") == 0)
 		{
 			if (argc <= (argi + 1))
 			{
@@ -1489,10 +3335,16 @@ int main(int argc, char *argv[])
 				return 1;
 			}
 
-			out_name = argv[argi + 1];
+			warmBootDir = argv[argi + 1];
+			if (!path_isdir(warmBootDir.c_str()) && !path_mkdir(warmBootDir.c_str()))
+			{
+				fprintf(stderr, "Error: Unable to create cache directory \"%s\"\n", warmBootDir.c_str());
+				return 1;
+			}
+			opt.SetWarmBootCache(warmBootDir, warmBootLength);
 			argi++;
 		}
-		else if (strcmp(argv[argi], "--psfby") == 0 || strcmp(argv[argi], "--snsfby") == 0)
+		else if (strcmp(argv[argi], "--warmup") == 0)
 		{
 			if (argc <= (argi + 1))
 			{
@@ -1500,10 +3352,11 @@ int main(int argc, char *argv[])
 				return 1;
 			}
 
-			psfby = argv[argi + 1];
+			warmBootLength = SnsfOpt::ToTimeValue(argv[argi + 1]);
+			opt.SetWarmBootCache(warmBootDir, warmBootLength);
 			argi++;
 		}
-		else if (strcmp(argv[argi], "--offset") == 0)
+		else if (strcmp(argv[argi], "--apu-log") == 0)
 		{
 			if (argc <= (argi + 1))
 			{
@@ -1511,18 +3364,22 @@ int main(int argc, char *argv[])
 				return 1;
 			}
 
-			l = strtol(argv[argi + 1], &endptr, 0);
-			if (*endptr != '\0' || errno == ERANGE || l < 0)
+			std::string apuLogDir = argv[argi + 1];
+			if (!path_isdir(apuLogDir.c_str()) && !path_mkdir(apuLogDir.c_str()))
 			{
-				fprintf(stderr, "Error: Number format error \"%s\"\n", argv[argi + 1]);
+				fprintf(stderr, "Error: Unable to create cache directory \"%s\"\n", apuLogDir.c_str());
 				return 1;
 			}
-			opt.SetSNSFBaseOffset((uint32_t)l);
+			opt.SetAPULogCache(apuLogDir);
 			argi++;
 		}
-		else if (strcmp(argv[argi], "-cs") == 0 || strcmp(argv[argi], "--fix-checksum") == 0)
+		else if (strcmp(argv[argi], "--idle-stats") == 0)
 		{
-			opt.FixROMChecksum = true;
+			opt.ShowIdleLoopStats = true;
+		}
+		else if (strcmp(argv[argi], "--audio-only") == 0)
+		{
+			opt.SetAudioOnly(true);
 		}
 		else
 		{
@@ -1545,12 +3402,66 @@ int main(int argc, char *argv[])
 					{
 						opt.DelayedSPCDump = true;
 					}
+					else if (strcmp(argv[argi], "-w") == 0)
+					{
+						if (argc <= (argi + 1))
+						{
+							fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+							return 1;
+						}
+
+						opt.SetSPCWipeLength(SnsfOpt::ToTimeValue(argv[argi + 1]));
+						argi++;
+					}
+					else if (strcmp(argv[argi], "-T") == 0)
+					{
+						if (argc <= (argi + 1))
+						{
+							fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+							return 1;
+						}
+
+						double capture_time = SnsfOpt::ToTimeValue(argv[argi + 1]);
+						if (capture_time != capture_time || capture_time < 0.0)
+						{
+							fprintf(stderr, "Error: Time format error \"%s\"\n", argv[argi + 1]);
+							return 1;
+						}
+
+						opt.AddSPCCaptureTime(capture_time);
+						opt.DelayedSPCDump = true;
+						argi++;
+					}
+					else if (strcmp(argv[argi], "-k") == 0)
+					{
+						if (argc <= (argi + 1))
+						{
+							fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+							return 1;
+						}
+
+						std::vector<int> key_ons;
+						if (!ParseKeyOnList(argv[argi + 1], key_ons))
+						{
+							fprintf(stderr, "Error: Key-on list format error \"%s\"\n", argv[argi + 1]);
+							return 1;
+						}
+
+						opt.SetSPCCaptureKeyOns(key_ons);
+						argi++;
+					}
 					else
 					{
 						fprintf(stderr, "Error: Unknown option \"%s\"\n", argv[argi]);
 						return 1;
 					}
 				}
+
+				if (opt.DelayedSPCDump && !opt.GetSPCCaptureKeyOns().empty())
+				{
+					fprintf(stderr, "Error: \"-k\" cannot be used with \"-d\" or \"-T\"\n");
+					return 1;
+				}
 			}
 			else if (mode == SNSFOPT_PROC_T)
 			{
@@ -1630,6 +3541,17 @@ int main(int argc, char *argv[])
 						opt.SetOneShotVerifyLength(SnsfOpt::ToTimeValue(argv[argi + 1]));
 						argi++;
 					}
+					else if (strcmp(argv[argi], "-g") == 0)
+					{
+						if (argc <= (argi + 1))
+						{
+							fprintf(stderr, "Error: Too few arguments for \"%s\"\n", argv[argi]);
+							return 1;
+						}
+
+						opt.SetOneShotGuardLength(SnsfOpt::ToTimeValue(argv[argi + 1]));
+						argi++;
+					}
 					else
 					{
 						fprintf(stderr, "Error: Unknown option \"%s\"\n", argv[argi]);
@@ -1650,7 +3572,7 @@ int main(int argc, char *argv[])
 
 	if (mode == SNSFOPT_PROC_NONE)
 	{
-		fprintf(stderr, "Error: You need to specify a processing mode, -f, -s, -l, -r, -x, -t\n");
+		fprintf(stderr, "Error: You need to specify a processing mode, -f, -s, -l, -r, -x, -t, -a\n");
 		return 1;
 	}
 
@@ -1714,20 +3636,24 @@ int main(int argc, char *argv[])
 				fprintf(stderr, "Error: %s\n", opt.message().c_str());
 				return 1;
 			}
-			for (uint32_t song = 0; song < minisnsf_count; song++)
+			opt.SetCheckpointTrigger(minisnsf_offset, minisnsf_size, true);
+			if (jobs > 1 && minisnsf_count > 1)
 			{
-				printf("Optimizing %s  Song value %X\n", argv[argi], song);
-
-				uint8_t patch[4] = {
-					static_cast<uint8_t>(song & 0xff),
-					static_cast<uint8_t>((song >> 8) & 0xff),
-					static_cast<uint8_t>((song >> 16) & 0xff),
-					static_cast<uint8_t>((song >> 24) & 0xff),
-				};
-				opt.PatchROM(minisnsf_offset, patch, minisnsf_size, true);
-				opt.ResetGame();
+				SnsfOptSweepJob job(opt, argv[argi], minisnsf_offset, minisnsf_size);
+				if (RunParallel(opt, job, (int)minisnsf_count, jobs) != 0)
+				{
+					return 1;
+				}
 
-				opt.Optimize();
+				// leave the ROM patched with the last song value, as the sequential sweep does
+				PatchSongValue(opt, minisnsf_offset, minisnsf_size, minisnsf_count - 1);
+			}
+			else
+			{
+				for (uint32_t song = 0; song < minisnsf_count; song++)
+				{
+					OptimizeSongValue(opt, argv[argi], minisnsf_offset, minisnsf_size, song);
+				}
 			}
 
 			std::map<std::string, std::string> tags;
@@ -1783,16 +3709,38 @@ int main(int argc, char *argv[])
 
 			// optimize
 			opt.ResetOptimizer();
-			for (; argi < argc; argi++)
+			if (jobs > 1 && argc - argi > 1)
 			{
-				printf("Optimizing %s\n", argv[argi]);
+				SnsfOptLibraryJob job(opt, &argv[argi]);
+				if (RunParallel(opt, job, argc - argi, jobs) != 0)
+				{
+					return 1;
+				}
 
-				if (!opt.LoadROMFile(argv[argi]))
+				// the snsflib is taken from the last file, as the sequential loop does
+				std::string discarded;
+				opt.SetConsoleBuffer(&discarded, &discarded);
+				bool loaded = opt.LoadROMFile(argv[argc - 1]);
+				opt.SetConsoleBuffer(NULL, NULL);
+				if (!loaded)
 				{
 					fprintf(stderr, "Error: %s\n", opt.message().c_str());
 					return 1;
 				}
-				opt.Optimize();
+			}
+			else
+			{
+				for (; argi < argc; argi++)
+				{
+					printf("Optimizing %s\n", argv[argi]);
+
+					if (!opt.LoadROMFile(argv[argi]))
+					{
+						fprintf(stderr, "Error: %s\n", opt.message().c_str());
+						return 1;
+					}
+					opt.Optimize();
+				}
 			}
 
 			std::map<std::string, std::string> tags;
@@ -1818,249 +3766,45 @@ int main(int argc, char *argv[])
 		}
 
 		case SNSFOPT_PROC_F:
-		{
-			if (argi + 1 < argc && !out_name.empty())
-			{
-				fprintf(stderr, "Error: Output filename cannot be specified to multiple ROMs.\n");
-				return 1;
-			}
-
-			// optimize
-			for (; argi < argc; argi++)
-			{
-				// determine output filename
-				std::string out_path = out_name;
-				if (out_name.empty())
-				{
-					const char *ext = path_findext(argv[argi]);
-					if (*ext == '\0')
-					{
-						out_path = argv[argi];
-						out_path += ".snsf";
-					}
-					else
-					{
-						out_path = std::string(argv[argi], ext - argv[argi]);
-						out_path += ".snsf";
-					}
-				}
-				else
-				{
-					out_path = out_name;
-
-					const char *ext = path_findext(out_name.c_str());
-					if (*ext == '\0')
-					{
-						out_path += ".snsf";
-					}
-				}
-
-				printf("Optimizing %s\n", argv[argi]);
-
-				opt.ResetOptimizer();
-				if (!opt.LoadROMFile(argv[argi]))
-				{
-					fprintf(stderr, "Error: %s\n", opt.message().c_str());
-					return 1;
-				}
-				opt.Optimize();
-
-				std::map<std::string, std::string> tags;
-				if (psfby != NULL && strcmp(psfby, "") != 0) {
-					tags["snsfby"] = psfby;
-				}
-
-				opt.SaveSNSF(out_path, 0, true, tags);
-
-				if (opt.GetParanoidClosedAreaFillSize() > 0) {
-					printf("Preserved any data within %d bytes between two used bytes.\n",
-						opt.GetParanoidClosedAreaFillSize());
-				}
-
-				if (opt.GetParanoidPostFillSize() > 0) {
-					printf("Preserved any data within %d trailing bytes of a used byte.\n",
-						opt.GetParanoidPostFillSize());
-				}
-
-				printf("Covered %u bytes. Preserved %d extra bytes.\n", opt.GetCoveredSize(), opt.GetParanoidFilledSize());
-			}
-			break;
-		}
-
 		case SNSFOPT_PROC_R:
+		case SNSFOPT_PROC_X:
+		case SNSFOPT_PROC_T:
+		case SNSFOPT_PROC_A:
 		{
-			if (argi + 1 < argc && !out_name.empty())
+			if (mode == SNSFOPT_PROC_T || mode == SNSFOPT_PROC_A)
 			{
-				fprintf(stderr, "Error: Output filename cannot be specified to multiple ROMs.\n");
-				return 1;
-			}
-
-			for (int i = argi; i < argc; i++)
-			{
-				std::string out_path;
-				if (out_name.empty())
-				{
-					const char *ext = path_findext(argv[i]);
-					if (*ext == '\0')
-					{
-						out_path = argv[i];
-						out_path += ".smc";
-					}
-					else
-					{
-						out_path = std::string(argv[i], ext - argv[i]);
-						out_path += ".smc";
-					}
-				}
-				else
-				{
-					out_path = out_name;
-
-					const char *ext = path_findext(out_name.c_str());
-					if (*ext == '\0')
-					{
-						out_path += ".smc";
-					}
-				}
-
-				if (!opt.LoadROMFile(argv[i]))
+				if (!out_name.empty())
 				{
-					fprintf(stderr, "Error: %s\n", opt.message().c_str());
+					fprintf(stderr, "Error: Output filename cannot be specified for \"%s\".\n", (mode == SNSFOPT_PROC_T) ? "-t" : "-a");
 					return 1;
 				}
-				opt.SaveROM(out_path, false);
 			}
-			break;
-		}
-
-		case SNSFOPT_PROC_X:
-		{
-			if (argi + 1 < argc && !out_name.empty())
+			else if (argi + 1 < argc && !out_name.empty())
 			{
 				fprintf(stderr, "Error: Output filename cannot be specified to multiple ROMs.\n");
 				return 1;
 			}
 
-			for (int i = argi; i < argc; i++)
-			{
-				std::string out_path;
-				if (out_name.empty())
-				{
-					const char *ext = path_findext(argv[i]);
-					if (*ext == '\0')
-					{
-						out_path = argv[i];
-						out_path += ".spc";
-					}
-					else
-					{
-						out_path = std::string(argv[i], ext - argv[i]);
-						out_path += ".spc";
-					}
-				}
-				else
-				{
-					out_path = out_name;
-
-					const char *ext = path_findext(out_name.c_str());
-					if (*ext == '\0')
-					{
-						out_path += ".spc";
-					}
-				}
-
-				opt.ResetOptimizer(false);
-				if (!opt.LoadROMFile(argv[i]))
-				{
-					fprintf(stderr, "Error: %s\n", opt.message().c_str());
-					return 1;
-				}
-
-				opt.ClearSPCTags();
-				if (PSFFile::IsPSFFile(argv[i])) {
-					PSFFile * psf_file = PSFFile::load(argv[i]);
-					if (psf_file != NULL) {
-						opt.SetSPCTags(psf_file->tags);
-						delete psf_file;
-					}
-				}
-
-				opt.DumpSPC(out_path);
-			}
-			break;
-		}
+			SnsfOptBatch batch;
+			batch.mode = mode;
+			batch.out_name = out_name;
+			batch.psfby = psfby;
+			batch.add_snsf_tags = addSNSFTags;
+			batch.loop_fade_length = loopFadeLength;
+			batch.oneshot_postgap_length = oneshotPostgapLength;
 
-		case SNSFOPT_PROC_T:
-		{
-			if (!out_name.empty())
+			if (jobs > 1 && argc - argi > 1)
 			{
-				fprintf(stderr, "Error: Output filename cannot be specified for \"-t\".\n");
-				return 1;
+				SnsfOptBatchJob job(batch, &argv[argi]);
+				return RunParallel(opt, job, argc - argi, jobs);
 			}
 
-			// optimize
 			for (; argi < argc; argi++)
 			{
-				// determine output filename
-				std::string out_path = argv[argi];
-
-				opt.ResetOptimizer();
-				if (!opt.LoadROMFile(argv[argi]))
+				if (!ProcessBatchFile(opt, batch, argv[argi]))
 				{
-					fprintf(stderr, "Error: %s\n", opt.message().c_str());
 					return 1;
 				}
-				opt.Optimize();
-
-#ifdef _DEBUG
-				//for (int count = 1; count <= opt.GetTargetLoopCount(); count++)
-				//{
-				//	printf("Loop Point %d = %s\n", count, opt.GetLoopPointString(count).c_str());
-				//}
-#endif
-
-				if (addSNSFTags)
-				{
-					PSFFile * snsf = PSFFile::load(argv[argi]);
-					if (snsf == NULL)
-					{
-						fprintf(stderr, "Error: Invalid PSF file %s (file operation error)\n", argv[argi]);
-						return 1;
-					}
-
-					if (opt.IsOneShot())
-					{
-						if (opt.GetOneShotEndPoint() == opt.GetInitialSilenceLength())
-						{
-							snsf->tags["length"] = "0";
-						}
-						else
-						{
-							snsf->tags["length"] = SnsfOpt::ToTimeString(opt.GetOneShotEndPoint() + oneshotPostgapLength - opt.GetInitialSilenceLength(), false);
-						}
-						snsf->tags["fade"] = "0";
-					}
-					else
-					{
-						snsf->tags["length"] = SnsfOpt::ToTimeString(opt.GetLoopPoint() - opt.GetInitialSilenceLength(), false);
-
-						if (loopFadeLength >= 0.001)
-						{
-							snsf->tags["fade"] = SnsfOpt::ToTimeString(loopFadeLength, false);
-						}
-						else
-						{
-							snsf->tags["fade"] = "0";
-						}
-					}
-
-					if (!snsf->save(out_path)) {
-						fprintf(stderr, "Error: Unable to save PSF file %s\n", argv[argi]);
-						return 1;
-					}
-
-					delete snsf;
-				}
 			}
 			break;
 		}
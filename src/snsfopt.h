@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <string>
 #include <map>
+#include <vector>
 
 #ifdef WIN32
 #include <Windows.h>
@@ -20,23 +21,60 @@ public:
 
 	bool LoadROM(const uint8_t * rom, uint32_t romsize, const uint8_t * sram, uint32_t sramsize);
 	bool LoadROMFile(const std::string& filename);
+	bool LoadSPCFile(const std::string& filename);
 	void PatchROM(uint32_t offset, const void * data, uint32_t size, bool apply_base_offset);
 	void ResetGame(void);
 
+	// Takes a checkpoint at the start of the frame that first reads the given
+	// ROM range during the next run. ResumeGame() then restarts from there
+	// instead of resetting, so the range can be patched without booting the
+	// game again. Loading another game clears the checkpoint.
+	void SetCheckpointTrigger(uint32_t offset, uint32_t size, bool apply_base_offset);
+	void ClearCheckpoint(void);
+	void ResumeGame(void);
+
+	// Warm boot cache: a run from reset keeps its state after [warmup] seconds
+	// in [dir], keyed by the loaded game and the options that affect the run.
+	// Later runs of the same game continue from there. An empty dir disables it.
+	void SetWarmBootCache(const std::string & dir, double warmup);
+
+	// APU log cache: a timing run from reset keeps a log of what the 65c816
+	// did to the APU in [dir]. Later timing runs of the same game replay the
+	// log on the APU alone, whatever their loop and silence options, and
+	// emulate the whole system again only past its end. Logs are keyed by the
+	// game and the state layout version. An empty dir disables it.
+	void SetAPULogCache(const std::string & dir);
+
 	void ResetOptimizer(bool dsp_reset_accuracy = true);
 	virtual void Optimize(void);
 	virtual void DumpSPC(const std::string & filename);
+	// Plays the song from reset in the normal profile until no new data has
+	// been found for the timeout, then as long again in the audio-only
+	// profile, and reports whether the output and ROM coverage differ
+	virtual void CompareAudioOnly(void);
 	void Run(void (SnsfOpt::*Start)(), void (SnsfOpt::*BeforeLoop)(), void (SnsfOpt::*AfterLoop)(), bool (SnsfOpt::*Finished)(), void (SnsfOpt::*End)(), void (SnsfOpt::*ShowProgress)() const, void (SnsfOpt::*ShowResult)() const);
 
 	void SetSPCTags(const std::map<std::string, std::string> & tags);
 	void ClearSPCTags(void);
 
+	// Adds the ROM coverage collected by another optimizer running the same game
+	void MergeCoverage(const SnsfOpt & src);
+
 	bool GetROM(void * rom, uint32_t size, bool wipe_unused_data);
 	bool SaveROM(const std::string& filename, bool wipe_unused_data);
 	bool SaveSNSF(const std::string& filename, uint32_t base_offset, bool wipe_unused_data, std::map<std::string, std::string>& tags);
 
 	bool DelayedSPCDump;
 	bool FixROMChecksum;
+	bool ShowIdleLoopStats;
+
+	void CopySettings(const SnsfOpt & src);
+
+	// Console output goes to stdout/stderr unless buffers are attached.
+	// Progress display is suppressed while output is buffered.
+	void SetConsoleBuffer(std::string * out, std::string * err);
+	void Print(const char * format, ...) const;
+	void PrintError(const char * format, ...) const;
 
 	inline uint32_t GetROMSize(void) const
 	{
@@ -83,6 +121,11 @@ public:
 		return ToTimeString(GetLoopPoint(count));
 	}
 
+	inline bool IsWarmBootCacheHit(void) const
+	{
+		return warm_boot_hit;
+	}
+
 	inline bool IsOneShot(void) const
 	{
 		return oneshot;
@@ -128,6 +171,66 @@ public:
 		oneshot_verify_length = length;
 	}
 
+	// A one shot also ends once every voice has released and nothing was
+	// keyed on for this long, with the output silent as long (0 = disabled)
+	inline double GetOneShotGuardLength(void) const
+	{
+		return oneshot_guard_length;
+	}
+
+	inline void SetOneShotGuardLength(double length)
+	{
+		oneshot_guard_length = length;
+	}
+
+	// Audio-only profile: graphics DMA/HDMA takes its time without
+	// transferring, and its source is not counted as used
+	inline bool GetAudioOnly(void) const
+	{
+		return m_system->GetAudioOnly();
+	}
+
+	inline void SetAudioOnly(bool audio_only)
+	{
+		m_system->SetAudioOnly(audio_only);
+	}
+
+	// SPC export keeps emulating this long after the snapshot, then wipes the
+	// APU RAM that was not touched meanwhile (0 = disabled)
+	inline double GetSPCWipeLength(void) const
+	{
+		return spc_wipe_length;
+	}
+
+	inline void SetSPCWipeLength(double length)
+	{
+		spc_wipe_length = length;
+	}
+
+	// delayed SPC export takes a snapshot at each of these times
+	// (none = the optimizer timeout)
+	inline void AddSPCCaptureTime(double time)
+	{
+		spc_capture_times.push_back(time);
+	}
+
+	inline void ClearSPCCaptureTimes(void)
+	{
+		spc_capture_times.clear();
+	}
+
+	// SPC export takes a snapshot at each of these key-ons (sorted, from 1)
+	// instead of the first one only (empty = the first one)
+	inline const std::vector<int> & GetSPCCaptureKeyOns(void) const
+	{
+		return spc_capture_key_ons;
+	}
+
+	inline void SetSPCCaptureKeyOns(const std::vector<int> & key_ons)
+	{
+		spc_capture_key_ons = key_ons;
+	}
+
 	inline uint32_t GetParanoidClosedAreaFillSize(void) const
 	{
 		return paranoid_closed_area_fill_size;
@@ -181,15 +284,27 @@ protected:
 		uint32_t silent_samples_received;
 		uint16_t silence_threshold;
 		uint32_t silence_start;
+		bool silence_started;	// the current silence began in this frame
 
 		bool initial_silence_captured;
 		uint32_t initial_silence_samples;
 
+		// checksum of each block of output, while capturing
+		std::vector<uint32_t> * block_checksums;
+		uint32_t block_checksum;
+		uint32_t block_samples;
+		uint32_t capture_samples;	// captured so far
+		uint32_t capture_limit;	// 0 = no limit
+
 		snsf_sound_out() :
 			sample_rate(32000),
 			silence_threshold(8),
+			silence_started(false),
 			initial_silence_samples(0),
-			initial_silence_captured(false)
+			initial_silence_captured(false),
+			block_checksums(NULL),
+			capture_samples(0),
+			capture_limit(0)
 		{
 			reset_timer();
 		}
@@ -201,6 +316,11 @@ protected:
 		// Receives signed 16-bit stereo audio and a byte count
 		virtual void write(const void * samples, unsigned long bytes)
 		{
+			if (block_checksums != NULL)
+			{
+				capture((const int16_t *)samples, bytes / 2);
+			}
+
 			samples_received += (bytes / 2);
 
 			for (unsigned int i = 0; i < (bytes / 2); i++)
@@ -211,6 +331,7 @@ protected:
 					if (silent_samples_received == 0)
 					{
 						silence_start = samples_received;
+						silence_started = true;
 					}
 					silent_samples_received++;
 
@@ -233,10 +354,22 @@ protected:
 			}
 		}
 
+		// A silence is taken to start at the end of the frame it began in,
+		// however the frame's output was split into writes
+		void end_frame(void)
+		{
+			if (silence_started && silent_samples_received != 0)
+			{
+				silence_start = samples_received;
+			}
+			silence_started = false;
+		}
+
 		void reset_timer(void)
 		{
 			samples_received = 0;
 			silence_start = 0;
+			silence_started = false;
 			silent_samples_received = 0;
 			initial_silence_samples = 0;
 			initial_silence_captured = false;
@@ -261,6 +394,16 @@ protected:
 		{
 			return (double)initial_silence_samples / 2 / sample_rate;
 		}
+
+		// Output is checksummed per block of this many samples (50 ms)
+		static const uint32_t capture_block_size = 2 * 1600;
+
+		// Starts appending the checksum of each full block to checksums,
+		// for at most limit samples (NULL stops capturing)
+		void start_capture(std::vector<uint32_t> * checksums, uint32_t limit = 0);
+		void capture(const int16_t * samples, unsigned long count);
+		// Appends the checksum of the last, partial block
+		void flush_capture(void);
 	};
 	snsf_sound_out m_output;
 
@@ -283,6 +426,7 @@ protected:
 	uint8_t target_loop_count;
 	double loop_verify_length;
 	double oneshot_verify_length;
+	double oneshot_guard_length;
 
 	double time_last_new_data;
 	double loop_point_raw[256];
@@ -292,10 +436,74 @@ protected:
 	double oneshot_endpoint;
 	bool oneshot;
 	double initial_silence_length;
+	double voice_activity_end;
+
+	// Emulator and optimizer state at the start of a frame
+	struct checkpoint_t
+	{
+		std::vector<uint8_t> state;
+		snsf_sound_out output;
+		uint32_t rom_refs_histogram[256];
+		uint32_t apuram_refs_histogram[256];
+		double song_endpoint;
+		double optimize_endpoint;
+		double time_last_new_data;
+		double loop_point_raw[256];
+		double loop_point[256];
+		bool loop_point_updated[256];
+		uint8_t loop_count;
+		double oneshot_endpoint;
+		bool oneshot;
+		double initial_silence_length;
+		double voice_activity_end;
+	};
+	checkpoint_t checkpoint;
+	checkpoint_t checkpoint_candidate;
+	bool checkpoint_valid;
+	bool checkpoint_resumed;
+	bool checkpoint_abandoned;	// the trigger was not read in time, stop capturing
+	uint32_t checkpoint_trigger_offset;
+	uint32_t checkpoint_trigger_size;
+
+	std::string warm_boot_dir;
+	double warm_boot_length;
+	uint64_t game_hash;
+	bool run_from_reset;
+	bool warm_boot_pending;
+	bool warm_boot_hit;
+	double warm_boot_time;
+	double warm_boot_max_idle;
+
+	std::string apu_log_dir;
+	std::vector<uint8_t> apu_log;
+	std::vector<uint8_t> apu_log_rom_loops;	// ROM loop count bound of each frame
+	std::vector<uint8_t> apu_log_start_state;
+	std::vector<uint8_t> apu_log_end_state;
+	size_t apu_log_pos;
+	size_t apu_log_frame;
+	bool apu_log_recording;
+	bool apu_log_replaying;
+	double apu_log_replay_time;
 
 	std::string spc_dump_filename;
 	std::map<std::string, std::string> spc_tags;
-	SPCFile * spc_snapshot_dumped;
+	std::vector<SPCFile *> spc_snapshots_dumped;
+	std::vector<double> spc_capture_times;
+	std::vector<int> spc_capture_key_ons;
+	std::vector<double> spc_dump_times;	// delayed captures still to take, in order
+	size_t spc_dump_count;
+	bool spc_dump_captured;
+	double spc_snapshot_time;
+	double spc_wipe_length;
+	uint32_t spc_wiped_size;
+
+	int compare_pass;	// 0 = normal profile, 1 = audio-only
+	double compare_length;
+	uint32_t compare_samples;	// captured by the normal pass
+	double compare_start_time;
+	double compare_elapsed[2];
+	uint32_t compare_rom_bytes[2];
+	std::vector<uint32_t> compare_checksums[2];
 
 	uint32_t paranoid_closed_area_fill_size;
 	uint32_t paranoid_post_fill_size;
@@ -306,6 +514,19 @@ protected:
 
 	static uint32_t MergeRefs(uint8_t * dst_refs, const uint8_t * src_refs, uint32_t size);
 
+	void SaveCheckpoint(checkpoint_t & cp);
+	void RestoreCheckpointVariables(const checkpoint_t & cp);
+	bool IsCheckpointTriggered(void) const;
+
+	std::string GetWarmBootPath(void) const;
+	bool LoadWarmBoot(void);
+	bool SaveWarmBoot(void);
+
+	std::string GetAPULogPath(void) const;
+	bool LoadAPULog(void);
+	bool SaveAPULog(void);
+	void RunFrame(void);
+
 	void Optimize_Start(void);
 	void Optimize_BeforeLoop(void);
 	void Optimize_AfterLoop(void);
@@ -321,6 +542,17 @@ protected:
 	void SPCDump_End(void);
 	void SPCDump_ShowProgress(void) const;
 	void SPCDump_ShowResult(void) const;
+	void WipeUnusedAPURAM(SPCFile & spc);
+	void ClearSPCSnapshots(void);
+
+	void Compare_Start(void);
+	void Compare_BeforeLoop(void);
+	void Compare_AfterLoop(void);
+	bool Compare_Finished(void);
+	void Compare_End(void);
+	void Compare_ShowProgress(void) const;
+	void Compare_ShowResult(void) const;
+	std::string GetSPCDumpPath(size_t index) const;
 
 	virtual void DetectLoop(void);
 	virtual void DetectOneShot(void);
@@ -329,6 +561,9 @@ protected:
 
 	std::string m_message;
 
+	std::string * console_out;
+	std::string * console_err;
+
 private:
 	virtual uint8_t ExpectPossibleLoopCount(const uint32_t * histogram, const uint32_t * new_histogram) const;
 
@@ -0,0 +1,148 @@
+// Checks the SSE2 BRR decoder against the scalar one. The same songs run on
+// the emulator built with each; the scalar build writes the output, the DSP
+// registers and the APU RAM of every frame, and the SSE2 build checks its own
+// against them.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include <zlib.h>
+
+#include "SNESSystem.h"
+#include "test_rom.h"
+
+static const int test_frames = 300;
+
+struct crc_sound_out : public SNESSoundOut
+{
+	uLong crc;
+
+	crc_sound_out() : crc(crc32(0, Z_NULL, 0))
+	{
+	}
+
+	virtual void write(const void * samples, unsigned long bytes)
+	{
+		crc = crc32(crc, (const Bytef *)samples, (uInt)bytes);
+	}
+};
+
+struct frame_result
+{
+	unsigned long sound_crc;
+	unsigned long dsp_crc;
+	unsigned long ram_crc;
+};
+
+class TestRun
+{
+public:
+	explicit TestRun(uint8_t song) : rom(MakeTestROM(song))
+	{
+		system.Load(rom.data(), (uint32_t)rom.size(), NULL, 0);
+		system.SoundInit(&output);
+		system.Init();
+		system.Reset();
+	}
+
+	bool RunFrame(frame_result & result)
+	{
+		system.CPULoop();
+
+		std::unique_ptr<SPCFile> spc(system.DumpSPCSnapshotImmediately());
+		if (!spc)
+		{
+			return false;
+		}
+
+		result.sound_crc = output.crc;
+		result.dsp_crc = crc32(crc32(0, Z_NULL, 0), spc->dsp, sizeof(spc->dsp));
+		result.ram_crc = crc32(crc32(0, Z_NULL, 0), spc->ram, sizeof(spc->ram));
+		return true;
+	}
+
+private:
+	std::vector<uint8_t> rom;
+	crc_sound_out output;
+	SNESSystem system;
+};
+
+int main(int argc, char * argv[])
+{
+	bool write;
+	if (argc == 3 && strcmp(argv[1], "write") == 0)
+	{
+		write = true;
+	}
+	else if (argc == 3 && strcmp(argv[1], "check") == 0)
+	{
+		write = false;
+	}
+	else
+	{
+		printf("usage: brr_test write|check [reference file]\n");
+		return 1;
+	}
+
+	FILE * fp = fopen(argv[2], write ? "w" : "r");
+	if (fp == NULL)
+	{
+		printf("%s: cannot open\n", argv[2]);
+		return 1;
+	}
+
+	bool ok = true;
+	for (uint8_t song = 0; song < 8 && ok; song++)
+	{
+		TestRun run(song);
+		for (int frame = 0; frame < test_frames && ok; frame++)
+		{
+			frame_result result;
+			if (!run.RunFrame(result))
+			{
+				printf("song %d, frame %d: no SPC snapshot\n", song, frame);
+				ok = false;
+			}
+			else if (write)
+			{
+				fprintf(fp, "%08lx %08lx %08lx\n", result.sound_crc, result.dsp_crc, result.ram_crc);
+			}
+			else
+			{
+				frame_result expected;
+				if (fscanf(fp, "%lx %lx %lx", &expected.sound_crc, &expected.dsp_crc, &expected.ram_crc) != 3)
+				{
+					printf("song %d, frame %d: missing from the reference\n", song, frame);
+					ok = false;
+				}
+				else if (result.sound_crc != expected.sound_crc || result.dsp_crc != expected.dsp_crc || result.ram_crc != expected.ram_crc)
+				{
+					printf("song %d, frame %d: %s differs from the scalar decoder\n", song, frame,
+						(result.sound_crc != expected.sound_crc) ? "output" : (result.dsp_crc != expected.dsp_crc) ? "a DSP register" : "APU RAM");
+					ok = false;
+				}
+			}
+		}
+	}
+
+	fclose(fp);
+
+	if (!ok)
+	{
+		return 1;
+	}
+
+	if (write)
+	{
+		printf("wrote %d frames of 8 songs with the scalar BRR decoder\n", test_frames);
+	}
+	else
+	{
+		printf("%d frames of 8 songs match the scalar BRR decoder\n", test_frames);
+	}
+	return 0;
+}
@@ -0,0 +1,164 @@
+// Runs two emulators side by side, interleaved frame by frame on one thread
+// and then each on its own thread, and checks that both produce the same
+// output and coverage as when they run alone.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+#include "SNESSystem.h"
+#include "test_rom.h"
+
+static const int test_frames = 300;
+
+struct crc_sound_out : public SNESSoundOut
+{
+	uLong crc;
+	unsigned long bytes_received;
+
+	crc_sound_out() : crc(crc32(0, Z_NULL, 0)), bytes_received(0)
+	{
+	}
+
+	virtual void write(const void * samples, unsigned long bytes)
+	{
+		crc = crc32(crc, (const Bytef *)samples, (uInt)bytes);
+		bytes_received += bytes;
+	}
+};
+
+struct run_result
+{
+	uLong sound_crc;
+	unsigned long sound_bytes;
+	uLong rom_coverage_crc;
+	uLong apuram_coverage_crc;
+
+	bool operator==(const run_result & other) const
+	{
+		return sound_crc == other.sound_crc && sound_bytes == other.sound_bytes &&
+			rom_coverage_crc == other.rom_coverage_crc && apuram_coverage_crc == other.apuram_coverage_crc;
+	}
+};
+
+class TestRun
+{
+public:
+	explicit TestRun(uint8_t song) : rom(MakeTestROM(song))
+	{
+		system.Load(rom.data(), (uint32_t)rom.size(), NULL, 0);
+		system.SoundInit(&output);
+		system.Init();
+		system.Reset();
+	}
+
+	void RunFrame(void)
+	{
+		system.CPULoop();
+	}
+
+	void RunFrames(int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			RunFrame();
+		}
+	}
+
+	run_result GetResult(void) const
+	{
+		run_result result;
+		result.sound_crc = output.crc;
+		result.sound_bytes = output.bytes_received;
+		result.rom_coverage_crc = crc32(crc32(0, Z_NULL, 0), system.GetROMCoverage(), system.GetROMCoverageSize());
+		result.apuram_coverage_crc = crc32(crc32(0, Z_NULL, 0), system.GetAPURAMCoverage(), system.GetAPURAMCoverageSize());
+		return result;
+	}
+
+private:
+	std::vector<uint8_t> rom;
+	crc_sound_out output;
+	SNESSystem system;
+};
+
+static bool Check(const char * name, const run_result & result, const run_result & expected)
+{
+	if (result == expected)
+	{
+		return true;
+	}
+
+	printf("%s: sound %08lx (%lu bytes), ROM coverage %08lx, APU RAM coverage %08lx\n",
+		name, result.sound_crc, result.sound_bytes, result.rom_coverage_crc, result.apuram_coverage_crc);
+	printf("%*s  expected %08lx (%lu bytes), ROM coverage %08lx, APU RAM coverage %08lx\n",
+		(int)strlen(name), "", expected.sound_crc, expected.sound_bytes, expected.rom_coverage_crc, expected.apuram_coverage_crc);
+	return false;
+}
+
+int main(void)
+{
+	const uint8_t songs[2] = { 0, 5 };
+	run_result alone[2];
+
+	for (int i = 0; i < 2; i++)
+	{
+		TestRun run(songs[i]);
+		run.RunFrames(test_frames);
+		alone[i] = run.GetResult();
+	}
+
+	if (alone[0].sound_crc == alone[1].sound_crc || alone[0].sound_bytes == 0)
+	{
+		printf("the two songs do not produce distinct output\n");
+		return 1;
+	}
+
+	bool ok = true;
+
+	// Interleaved on this thread, a frame each in turn
+	{
+		TestRun run0(songs[0]);
+		TestRun run1(songs[1]);
+		for (int frame = 0; frame < test_frames; frame++)
+		{
+			run0.RunFrame();
+			run1.RunFrame();
+		}
+		ok &= Check("interleaved song 0", run0.GetResult(), alone[0]);
+		ok &= Check("interleaved song 5", run1.GetResult(), alone[1]);
+	}
+
+	// At the same time on two threads
+	{
+		run_result threaded[2];
+		std::thread threads[2];
+		for (int i = 0; i < 2; i++)
+		{
+			threads[i] = std::thread([i, &songs, &threaded]()
+			{
+				TestRun run(songs[i]);
+				run.RunFrames(test_frames);
+				threaded[i] = run.GetResult();
+			});
+		}
+		for (int i = 0; i < 2; i++)
+		{
+			threads[i].join();
+		}
+		ok &= Check("threaded song 0", threaded[0], alone[0]);
+		ok &= Check("threaded song 5", threaded[1], alone[1]);
+	}
+
+	if (!ok)
+	{
+		return 1;
+	}
+
+	printf("%d frames of two systems side by side match the separate runs\n", test_frames);
+	return 0;
+}
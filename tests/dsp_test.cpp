@@ -0,0 +1,112 @@
+// Runs the full DSP and the coverage-only DSP side by side and checks after
+// every frame that the SMP sees the same: APU RAM, the DSP registers and the
+// ROM and APU RAM coverage.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "SNESSystem.h"
+#include "test_rom.h"
+
+static const int test_frames = 300;
+
+struct null_sound_out : public SNESSoundOut
+{
+	virtual void write(const void * /*samples*/, unsigned long /*bytes*/)
+	{
+	}
+};
+
+class TestRun
+{
+public:
+	TestRun(uint8_t song, bool coverage_only) : rom(MakeTestROM(song))
+	{
+		system.Load(rom.data(), (uint32_t)rom.size(), NULL, 0);
+		system.SetDSPCoverageOnly(coverage_only);
+		system.SoundInit(&output);
+		system.Init();
+		system.Reset();
+	}
+
+	void RunFrame(void)
+	{
+		system.CPULoop();
+	}
+
+	const SNESSystem & GetSystem(void) const
+	{
+		return system;
+	}
+
+private:
+	std::vector<uint8_t> rom;
+	null_sound_out output;
+	SNESSystem system;
+};
+
+static bool Compare(const char * what, const uint8_t * full, const uint8_t * coverage_only, size_t size, int song, int frame)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		if (full[i] != coverage_only[i])
+		{
+			printf("song %d, frame %d: %s differs at $%04x (%02x, coverage-only %02x)\n",
+				song, frame, what, (unsigned)i, full[i], coverage_only[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool TestSong(uint8_t song)
+{
+	TestRun full(song, false);
+	TestRun coverage_only(song, true);
+
+	for (int frame = 0; frame < test_frames; frame++)
+	{
+		full.RunFrame();
+		coverage_only.RunFrame();
+
+		std::unique_ptr<SPCFile> full_spc(full.GetSystem().DumpSPCSnapshotImmediately());
+		std::unique_ptr<SPCFile> coverage_only_spc(coverage_only.GetSystem().DumpSPCSnapshotImmediately());
+		if (!full_spc || !coverage_only_spc)
+		{
+			printf("song %d, frame %d: no SPC snapshot\n", song, frame);
+			return false;
+		}
+
+		const SNESSystem & a = full.GetSystem();
+		const SNESSystem & b = coverage_only.GetSystem();
+		if (!Compare("APU RAM", full_spc->ram, coverage_only_spc->ram, sizeof(full_spc->ram), song, frame) ||
+			!Compare("DSP register", full_spc->dsp, coverage_only_spc->dsp, sizeof(full_spc->dsp), song, frame) ||
+			!Compare("ROM coverage", a.GetROMCoverage(), b.GetROMCoverage(), a.GetROMCoverageSize(), song, frame) ||
+			!Compare("APU RAM coverage", a.GetAPURAMCoverage(), b.GetAPURAMCoverage(), a.GetAPURAMCoverageSize(), song, frame))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(void)
+{
+	bool ok = true;
+	for (uint8_t song = 0; song < 8; song++)
+	{
+		ok &= TestSong(song);
+	}
+
+	if (!ok)
+	{
+		return 1;
+	}
+
+	printf("%d frames of 8 songs match between the full and the coverage-only DSP\n", test_frames);
+	return 0;
+}
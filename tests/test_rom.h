@@ -0,0 +1,200 @@
+#ifndef TEST_ROM_H_INCLUDED
+#define TEST_ROM_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+// A 32 KB LoROM for the tests. It uploads a small sound driver and one of
+// eight songs to the APU, then idles and DMAs ROM data to VRAM, CGRAM and
+// WRAM on every NMI. The driver plays two voices with echo feedback, and
+// sweeps FIR1 while it waits, so the SMP changes the FIR in mid-sample. At
+// the end of each note it keeps OUTX of voice 0 in $03.
+
+static const uint8_t test_rom_cpu_code[] = {
+	// reset ($8000)
+	0x78, 0x18, 0xFB,				// SEI ; CLC ; XCE
+	0xC2, 0x10, 0xE2, 0x20,			// REP #$10 ; SEP #$20
+	0xA2, 0xFF, 0x1F, 0x9A,			// LDX #$1FFF ; TXS
+	0xAD, 0x40, 0x21, 0xC9, 0xAA,	// LDA $2140 ; CMP #$AA (IPL ready)
+	0xD0, 0xF9,						// BNE -7
+	0xA9, 0xCC, 0x85, 0x12,			// LDA #$CC ; STA $12 (IPL kick)
+	0xA2, 0x00, 0x90, 0xA0, 0x00, 0x06,	// LDX #$9000 ; LDY #$0600
+	0xA9, 0x00, 0x85, 0x10, 0xA9, 0x02, 0x85, 0x11,	// to APU $0200
+	0x20, 0xFB, 0x80,				// JSR upload
+	0xAD, 0x00, 0xF0,				// LDA $F000 (song number)
+	0xC2, 0x20, 0x29, 0x07, 0x00,	// REP #$20 ; AND #$0007
+	0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A,	// ASL x6
+	0x18, 0x69, 0x00, 0xA0, 0xAA, 0xE2, 0x20,	// CLC ; ADC #$A000 ; TAX ; SEP #$20
+	0xA0, 0x40, 0x00,				// LDY #$0040
+	0xA9, 0x00, 0x85, 0x10, 0xA9, 0x08, 0x85, 0x11,	// to APU $0800
+	0x20, 0xFB, 0x80,				// JSR upload
+	0xA9, 0x00, 0x8D, 0x42, 0x21, 0xA9, 0x02, 0x8D, 0x43, 0x21,	// run from $0200
+	0x9C, 0x41, 0x21, 0xA5, 0x12, 0x8D, 0x40, 0x21,
+	0xA9, 0x81, 0x8D, 0x00, 0x42,	// enable NMI and auto joypad read
+	// idle ($8061)
+	0xAD, 0x40, 0x21, 0x85, 0x20,	// LDA $2140 ; STA $20
+	0x80, 0xF9,						// BRA idle
+	// nmi ($8068)
+	0xC2, 0x30, 0x48, 0xDA, 0xE2, 0x20,	// REP #$30 ; PHA ; PHX ; SEP #$20
+	0xAD, 0x10, 0x42,				// LDA $4210
+	0xA9, 0x80, 0x8D, 0x15, 0x21,	// VMAIN = $80
+	0x9C, 0x16, 0x21, 0x9C, 0x17, 0x21,	// VMADD = 0
+	// channel 0: 512 bytes from $00:C000 to $2118/$2119
+	0xA9, 0x01, 0x8D, 0x00, 0x43, 0xA9, 0x18, 0x8D, 0x01, 0x43,
+	0xA9, 0x00, 0x8D, 0x02, 0x43, 0xA9, 0xC0, 0x8D, 0x03, 0x43, 0x9C, 0x04, 0x43,
+	0xA9, 0x00, 0x8D, 0x05, 0x43, 0xA9, 0x02, 0x8D, 0x06, 0x43,
+	0xA9, 0x01, 0x8D, 0x0B, 0x42,
+	// channel 1: 32 bytes from $00:C800 to $2122
+	0x9C, 0x21, 0x21,
+	0xA9, 0x00, 0x8D, 0x10, 0x43, 0xA9, 0x22, 0x8D, 0x11, 0x43,
+	0xA9, 0x00, 0x8D, 0x12, 0x43, 0xA9, 0xC8, 0x8D, 0x13, 0x43, 0x9C, 0x14, 0x43,
+	0xA9, 0x20, 0x8D, 0x15, 0x43, 0x9C, 0x16, 0x43,
+	0xA9, 0x02, 0x8D, 0x0B, 0x42,
+	// channel 2: 64 bytes from $00:CC00 to $2180
+	0x9C, 0x81, 0x21, 0x9C, 0x82, 0x21, 0x9C, 0x83, 0x21,
+	0xA9, 0x00, 0x8D, 0x20, 0x43, 0xA9, 0x80, 0x8D, 0x21, 0x43,
+	0xA9, 0x00, 0x8D, 0x22, 0x43, 0xA9, 0xCC, 0x8D, 0x23, 0x43, 0x9C, 0x24, 0x43,
+	0xA9, 0x40, 0x8D, 0x25, 0x43, 0x9C, 0x26, 0x43,
+	0xA9, 0x04, 0x8D, 0x0B, 0x42,
+	0xC2, 0x30, 0xFA, 0x68, 0x40,	// REP #$30 ; PLX ; PLA ; RTI
+	// upload ($80FB): Y bytes from X to the APU address at $10, IPL protocol
+	0xA5, 0x10, 0x8D, 0x42, 0x21, 0xA5, 0x11, 0x8D, 0x43, 0x21,
+	0xA9, 0x01, 0x8D, 0x41, 0x21, 0xA5, 0x12, 0x8D, 0x40, 0x21,
+	0xCD, 0x40, 0x21, 0xD0, 0xFB,	// wait for the echo of the kick
+	0x64, 0x13,						// STZ $13
+	0xBD, 0x00, 0x00, 0x8D, 0x41, 0x21, 0xA5, 0x13, 0x8D, 0x40, 0x21,
+	0xCD, 0x40, 0x21, 0xD0, 0xFB,
+	0xE6, 0x13, 0xE8, 0x88, 0xD0, 0xEA,	// INC $13 ; INX ; DEY ; BNE
+	0xA5, 0x13, 0x1A, 0xD0, 0x01, 0x1A,	// next kick = counter + 1, never 0
+	0x85, 0x12, 0x60,				// STA $12 ; RTS
+};
+
+static const uint8_t test_rom_spc_code[] = {
+	// $0200
+	0x20,							// CLRP
+	0xCD, 0xEF, 0xBD,				// MOV X,#$EF ; MOV SP,X
+	0xCD, 0x00,						// MOV X,#0
+	0xF5, 0x00, 0x07,				// MOV A,!$0700+X (DSP register table)
+	0x68, 0xFF, 0xF0, 0x0B,			// CMP A,#$FF ; BEQ +11
+	0xC4, 0xF2, 0x3D,				// MOV $F2,A ; INC X
+	0xF5, 0x00, 0x07, 0xC4, 0xF3, 0x3D,	// MOV A,!$0700+X ; MOV $F3,A ; INC X
+	0x2F, 0xEE,						// BRA -18
+	0x8F, 0x80, 0xFA,				// T0 target = 128 (62.5 Hz)
+	0x8F, 0x01, 0xF1,				// enable T0
+	0x8F, 0x00, 0x00, 0x8F, 0x08, 0x01,	// restart: song pointer = $0800
+	0x8D, 0x00, 0xF7, 0x00,			// next: MOV Y,#0 ; MOV A,[$00]+Y
+	0x68, 0xFF, 0xF0, 0xF2,			// CMP A,#$FF ; BEQ restart
+	0x68, 0xFE, 0xF0, 0x3E,			// CMP A,#$FE ; BEQ stop
+	0xC4, 0xF4,						// MOV $F4,A
+	0x8F, 0x1F, 0xF2, 0xC4, 0xF3,	// FIR1 = pitch
+	0x8F, 0x03, 0xF2, 0xC4, 0xF3,	// PITCHH(0) = pitch
+	0x8F, 0x13, 0xF2, 0xC4, 0xF3,	// PITCHH(1) = pitch
+	0x8F, 0x5C, 0xF2, 0x8F, 0x00, 0xF3,	// KOFF = 0
+	0xFC, 0xF7, 0x00,				// INC Y ; MOV A,[$00]+Y
+	0x8F, 0x4C, 0xF2, 0xC4, 0xF3,	// KON = voices
+	0xFC, 0xF7, 0x00, 0xC4, 0x02,	// INC Y ; MOV A,[$00]+Y ; MOV $02,A
+	0xAB, 0x00, 0xAB, 0x00, 0xAB, 0x00,	// song pointer += 3
+	0x8F, 0x1F, 0xF2,				// FIR1 from here on
+	0xAB, 0xF3,						// wait: INC $F3 (FIR1 sweeps)
+	0xE4, 0xFD, 0xF0, 0xFA,			// MOV A,$FD ; BEQ wait
+	0x8B, 0x02, 0xD0, 0xF6,			// DEC $02 ; BNE wait
+	0x8F, 0x09, 0xF2, 0xE4, 0xF3, 0xC4, 0x03,	// MOV $03,OUTX(0)
+	0x2F, 0xB6,						// BRA next
+	0x8F, 0x5C, 0xF2, 0x8F, 0x03, 0xF3,	// stop: KOFF = voices 0 and 1
+	0xE4, 0xFD, 0x2F, 0xFC,			// MOV A,$FD ; BRA -4
+};
+
+// Sample directory at $0300: square at $0400, saw at $0420 looping at $0432.
+// Between them they use all four BRR filters.
+static const uint8_t test_rom_spc_dir[] = {
+	0x00, 0x04, 0x00, 0x04, 0x20, 0x04, 0x32, 0x04,
+};
+
+static const uint8_t test_rom_spc_square[] = {
+	0xB3, 0x77, 0x77, 0x77, 0x77, 0x99, 0x99, 0x99, 0x99,
+};
+
+static const uint8_t test_rom_spc_saw[] = {
+	0xA4, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+	0x98, 0x12, 0x34, 0x56, 0x70, 0xFE, 0xDC, 0xBA, 0x98,
+	0xAF, 0x70, 0x70, 0x90, 0x90, 0x10, 0xF0, 0x31, 0xD3,
+};
+
+// DSP register and value pairs at $0700, ending with $FF
+static const uint8_t test_rom_spc_dsp_table[] = {
+	0x6C, 0x20, 0x5D, 0x03,			// FLG (echo writes off), DIR
+	0x00, 0x40, 0x01, 0x30, 0x02, 0x00, 0x03, 0x10, 0x04, 0x00, 0x05, 0x8E, 0x06, 0xE4,
+	0x10, 0x28, 0x11, 0x38, 0x12, 0x80, 0x13, 0x08, 0x14, 0x01, 0x15, 0xFA, 0x16, 0x6B,
+	0x0C, 0x60, 0x1C, 0x60,			// MVOL
+	0x2D, 0x00, 0x3D, 0x00,			// PMON, NON
+	0x6D, 0x60, 0x7D, 0x02, 0x4D, 0x02, 0x0D, 0x50,	// ESA, EDL, EON, EFB
+	0x0F, 0x60, 0x1F, 0x10, 0x2F, 0xF8, 0x3F, 0x08, 0x4F, 0x00, 0x5F, 0x04, 0x6F, 0xFC, 0x7F, 0x02,
+	0x2C, 0x30, 0x3C, 0xD0,			// EVOL
+	0x6C, 0x00,						// FLG (echo writes on)
+	0xFF,
+};
+
+// Returns the ROM image that plays song (0-7). Odd songs are one shots,
+// even songs loop.
+static std::vector<uint8_t> MakeTestROM(uint8_t song)
+{
+	std::vector<uint8_t> rom(0x8000, 0);
+
+	memcpy(&rom[0x0000], test_rom_cpu_code, sizeof(test_rom_cpu_code));
+
+	// APU image for $0200-$07FF
+	memcpy(&rom[0x1000], test_rom_spc_code, sizeof(test_rom_spc_code));
+	memcpy(&rom[0x1100], test_rom_spc_dir, sizeof(test_rom_spc_dir));
+	memcpy(&rom[0x1200], test_rom_spc_square, sizeof(test_rom_spc_square));
+	memcpy(&rom[0x1220], test_rom_spc_saw, sizeof(test_rom_spc_saw));
+	memcpy(&rom[0x1500], test_rom_spc_dsp_table, sizeof(test_rom_spc_dsp_table));
+
+	// Songs, 0x40 bytes each: pitch, voices and length of each note
+	for (int s = 0; s < 8; s++)
+	{
+		uint8_t * p = &rom[0x2000 + s * 0x40];
+		for (int i = 0; i < 3 + s; i++)
+		{
+			*p++ = 0x08 + (s * 3 + i * 5) % 0x18;
+			*p++ = (i % 3) ? 1 : 3;
+			*p++ = 20 + (i * 7 + s) % 40;
+		}
+		*p = (s % 2) ? 0xFE : 0xFF;
+	}
+
+	// DMA sources and some unused data
+	for (int i = 0x4000; i < 0x4200; i++)
+		rom[i] = (uint8_t)(i * 37);
+	for (int i = 0x4800; i < 0x4820; i++)
+		rom[i] = (uint8_t)(i * 11);
+	for (int i = 0x4C00; i < 0x4C40; i++)
+		rom[i] = (uint8_t)(i * 13);
+	memset(&rom[0x5000], 0xEA, 0x1000);
+
+	rom[0x7000] = song;
+
+	uint8_t * header = &rom[0x7FC0];
+	memcpy(header, "SNSFOPT TEST ROM     ", 21);
+	header[0x15] = 0x20;	// LoROM
+	header[0x17] = 0x05;	// 32 KB
+	header[0x19] = 0x01;
+	header[0x1A] = 0x33;
+
+	// NMI and reset vectors
+	rom[0x7FEA] = 0x68; rom[0x7FEB] = 0x80;
+	rom[0x7FFA] = 0x68; rom[0x7FFB] = 0x80;
+	rom[0x7FFC] = 0x00; rom[0x7FFD] = 0x80;
+
+	header[0x1C] = 0xFF; header[0x1D] = 0xFF;
+	uint16_t checksum = 0;
+	for (size_t i = 0; i < rom.size(); i++)
+		checksum += rom[i];
+	header[0x1C] = (uint8_t)~checksum; header[0x1D] = (uint8_t)(~checksum >> 8);
+	header[0x1E] = (uint8_t)checksum; header[0x1F] = (uint8_t)(checksum >> 8);
+
+	return rom;
+}
+
+#endif